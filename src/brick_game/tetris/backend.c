@@ -5,8 +5,11 @@
  * info and figure and its position on the game field
  */
 
+#define _POSIX_C_SOURCE 199309L
+
 #include <locale.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -14,44 +17,219 @@
 
 #include "../../include/tetris.h"
 
-static int init_field(int ***field, int rows, int cols);
-static void figures_choice(int **figure, int n);
-static int check_finished_row(int const *row);
+/**
+ * @brief Masks of all figures in all rotation states. Bit (i * 4 + j) is the
+ * cell in row i and column j of the figure matrix. I and O rotate in the whole
+ * 4x4 square, J, L, S, T and Z rotate in the 3x3 box under the top row (SRS)
+ */
+static const uint16_t figure_masks[NUMBER_OF_FIGURES][NUMBER_OF_ROTATIONS] = {
+    {0x00F0, 0x2222, 0x0F00, 0x4444}, /**< I */
+    {0x0660, 0x0660, 0x0660, 0x0660}, /**< O */
+    {0x0710, 0x3220, 0x4700, 0x2260}, /**< J */
+    {0x0740, 0x2230, 0x1700, 0x6220}, /**< L */
+    {0x0630, 0x1320, 0x6300, 0x2640}, /**< Z */
+    {0x0360, 0x2310, 0x3600, 0x4620}, /**< S */
+    {0x0720, 0x2320, 0x2700, 0x2620}  /**< T */
+};
+
+/**
+ * @brief Spawn offsets of all figures in all rotation states: {first filled
+ * column, last filled row} of the figure matrix
+ */
+static const int8_t figure_spawn_offsets[NUMBER_OF_FIGURES]
+                                        [NUMBER_OF_ROTATIONS][2] = {
+    {{0, 1}, {1, 3}, {0, 2}, {2, 3}}, /**< I */
+    {{1, 2}, {1, 2}, {1, 2}, {1, 2}}, /**< O */
+    {{0, 2}, {0, 3}, {0, 3}, {1, 3}}, /**< J */
+    {{0, 2}, {0, 3}, {0, 3}, {1, 3}}, /**< L */
+    {{0, 2}, {0, 3}, {0, 3}, {1, 3}}, /**< Z */
+    {{0, 2}, {0, 3}, {0, 3}, {1, 3}}, /**< S */
+    {{0, 2}, {0, 3}, {0, 3}, {1, 3}}  /**< T */
+};
+
+/**
+ * @brief Kick table used by each figure: 0 - J, L, S, T, Z, 1 - I, 2 - O
+ */
+static const int figure_kick_table[NUMBER_OF_FIGURES] = {1, 2, 0, 0, 0, 0, 0};
+
+/**
+ * @brief SRS kick offsets {dx, dy} tried in order on rotation from state [r]
+ * to state [(r + 1) % 4]: 0 -> L, L -> 2, 2 -> R, R -> 0. Y axis points down
+ * as on the game field
+ */
+static const int8_t figure_kicks[3][NUMBER_OF_ROTATIONS][NUMBER_OF_KICKS][2] = {
+    {{{0, 0}, {1, 0}, {1, -1}, {0, 2}, {1, 2}},
+     {{0, 0}, {-1, 0}, {-1, 1}, {0, -2}, {-1, -2}},
+     {{0, 0}, {-1, 0}, {-1, -1}, {0, 2}, {-1, 2}},
+     {{0, 0}, {1, 0}, {1, 1}, {0, -2}, {1, -2}}},
+    {{{0, 0}, {-1, 0}, {2, 0}, {-1, -2}, {2, 1}},
+     {{0, 0}, {-2, 0}, {1, 0}, {-2, 1}, {1, -2}},
+     {{0, 0}, {1, 0}, {-2, 0}, {1, 2}, {-2, -1}},
+     {{0, 0}, {2, 0}, {-1, 0}, {2, -1}, {-1, 2}}},
+    {{{0, 0}}, {{0, 0}}, {{0, 0}}, {{0, 0}}}};
+
+/**
+ * @brief Speed and gravity of a game level
+ */
+typedef struct {
+  int speed;   /**< Game tick, timeout for user input (milliseconds) */
+  int gravity; /**< Rows per tick, in 1/GRAVITY_UNIT of a row */
+} GravityLevel_t;
+
+/**
+ * @brief Gravity curve: entry [level - 1] is used for level, levels past the
+ * end of the table use the last entry. Levels up to MAX_LEVEL speed the tick
+ * up by SPEED_DECREMENT, further levels keep the fastest tick and raise
+ * gravity up to 20G
+ */
+static const GravityLevel_t gravity_table[] = {
+    {INITIAL_TIMEOUT - 0 * SPEED_DECREMENT, GRAVITY_UNIT},
+    {INITIAL_TIMEOUT - 1 * SPEED_DECREMENT, GRAVITY_UNIT},
+    {INITIAL_TIMEOUT - 2 * SPEED_DECREMENT, GRAVITY_UNIT},
+    {INITIAL_TIMEOUT - 3 * SPEED_DECREMENT, GRAVITY_UNIT},
+    {INITIAL_TIMEOUT - 4 * SPEED_DECREMENT, GRAVITY_UNIT},
+    {INITIAL_TIMEOUT - 5 * SPEED_DECREMENT, GRAVITY_UNIT},
+    {INITIAL_TIMEOUT - 6 * SPEED_DECREMENT, GRAVITY_UNIT},
+    {INITIAL_TIMEOUT - 7 * SPEED_DECREMENT, GRAVITY_UNIT},
+    {INITIAL_TIMEOUT - 8 * SPEED_DECREMENT, GRAVITY_UNIT},
+    {INITIAL_TIMEOUT - 9 * SPEED_DECREMENT, GRAVITY_UNIT},
+    {INITIAL_TIMEOUT - 9 * SPEED_DECREMENT, GRAVITY_UNIT * 3 / 2},
+    {INITIAL_TIMEOUT - 9 * SPEED_DECREMENT, GRAVITY_UNIT * 2},
+    {INITIAL_TIMEOUT - 9 * SPEED_DECREMENT, GRAVITY_UNIT * 3},
+    {INITIAL_TIMEOUT - 9 * SPEED_DECREMENT, GRAVITY_UNIT * 5},
+    {INITIAL_TIMEOUT - 9 * SPEED_DECREMENT, GRAVITY_20G}};
+
+/**
+ * @brief Memory block of one game: flat game state and row pointers of the
+ * GameInfo_t view and figure matrix. Row pointers point into the state of the
+ * same block and stay valid while the block is recycled
+ */
+typedef struct {
+  GameState_t state;                       /**< Flat game state */
+  cell_t *field_rows[FIELD_ROWS];          /**< Field row pointers */
+  int *next_rows[SIDE_OF_FIGURE_SQUARE];   /**< Next figure row pointers */
+  int *figure_rows[SIDE_OF_FIGURE_SQUARE]; /**< Figure row pointers */
+} GameArena_t;
+
+/**
+ * @brief Arenas of finished games kept for reuse by next games
+ */
+typedef struct {
+  GameArena_t *arenas[ARENA_POOL_SIZE]; /**< Free arenas */
+  int n;                                /**< Number of free arenas */
+} ArenaPool_t;
+
+static GameArena_t **updateGameArena(void);
+static int64_t *updateGameClock(void);
+static GameArena_t *current_arena(void);
+static ArenaPool_t *updateArenaPool(void);
+static GameArena_t *acquire_arena(void);
+static void release_arena(GameArena_t *arena);
+static void clear_arena(GameArena_t *arena);
+static uint32_t next_random(void);
+static void set_gravity_level(int level);
+static void mask_to_figure(int (*figure)[SIDE_OF_FIGURE_SQUARE],
+                           unsigned mask);
+static int check_collide_mask(unsigned mask, int x, int y);
+static int check_finished_row(cell_t const *row);
 static void shift_rows_down(int row);
+#ifndef USE_MOCK
+static void redraw_screen(void);
+#endif
 
 /**
- * @brief update game info. Keep static variable of game info, GameInfo_t
+ * @brief update game info. Keep static variable of game info, GameInfo_t,
+ * refreshed from the state of the current game
  *
  * @return pointer to game info
  */
 GameInfo_t *updateCurrentState(void) {
   static GameInfo_t game = {0};
+  GameArena_t *arena = *updateGameArena();
+  if (arena) {
+    game.field = arena->field_rows + HIDDEN_ROWS;
+    game.next = arena->next_rows;
+    game.score = arena->state.score;
+    game.high_score = arena->state.high_score;
+    game.level = arena->state.level;
+    game.speed = arena->state.speed;
+    game.pause = arena->state.pause;
+    game.lines = arena->state.lines;
+    memcpy(game.clears, arena->state.clears, sizeof(game.clears));
+    game.pieces = arena->state.pieces;
+    game.inputs = arena->state.inputs;
+  } else {
+    game.field = NULL;
+    game.next = NULL;
+  }
   return &game;
 }
 
 /**
- * @brief update figure. Keep static variable of figure, int **
+ * @brief update game state. State lives in arena of current game
  *
- * @return pointer to figure
+ * @return pointer to game state
+ */
+GameState_t *updateGameState(void) { return &current_arena()->state; }
+
+/**
+ * @brief update figure. Figure lives in state of current game
+ *
+ * @return pointer to figure, NULL if arena cannot be allocated
  */
 int **updateFigure(void) {
-  static int **figure = NULL;
-  if (figure == NULL)
-    init_field(&figure, SIDE_OF_FIGURE_SQUARE, SIDE_OF_FIGURE_SQUARE);
-  return figure;
+  GameArena_t *arena = current_arena();
+  return (arena) ? arena->figure_rows : NULL;
 }
 
 /**
- * @brief update figure position. Keep static variable of figure positon,
- * FigurePos_t
+ * @brief update game arena. Keep static pointer to arena of current game,
+ * GameArena_t *
+ *
+ * @return pointer to arena pointer
+ */
+static GameArena_t **updateGameArena(void) {
+  static GameArena_t *arena = NULL;
+  return &arena;
+}
+
+/**
+ * @brief arena of current game, acquires arena if there is none
+ *
+ * @return pointer to arena, NULL if allocation failed
+ */
+static GameArena_t *current_arena(void) {
+  GameArena_t **arena = updateGameArena();
+  if (*arena == NULL) *arena = acquire_arena();
+  return *arena;
+}
+
+/**
+ * @brief update arena pool. Keep static pool of free arenas, ArenaPool_t
+ *
+ * @return pointer to arena pool
+ */
+static ArenaPool_t *updateArenaPool(void) {
+  static ArenaPool_t pool = {0};
+  return &pool;
+}
+
+/**
+ * @brief update figure position. Figure position is part of game state
  *
  * @return pointer to figure position
  */
 FigurePos_t *updateFigurePosition(void) {
-  static FigurePos_t fig_pos = {0};
-  return &fig_pos;
+  return &updateGameState()->figure_pos;
 }
 
+/**
+ * @brief update game context. Game context is part of game state
+ *
+ * @return pointer to game context
+ */
+GameContext_t *updateGameContext(void) { return &updateGameState()->context; }
+
 /**
  * @brief Main game loop that controls the game flow
  * @details Manages game initialization, state transitions, user input
@@ -59,7 +237,16 @@ FigurePos_t *updateFigurePosition(void) {
  * GAMEOVER, etc.) and ensures proper resource cleanup on exit.
  *
  * The loop continues until the game reaches GAMEOVER or EXIT_ERROR state.
- * In MOVING and START states, it captures user input for game control.
+ * In MOVING, START and PAUSED states, it sleeps in the event loop until a key,
+ * game tick or signal comes and dispatches it to the state machine: keys as
+ * actions, ticks as no signal, SIGTERM/SIGINT end the loop, SIGWINCH lays out
+ * and draws the whole screen again, watched sockets are handled by their
+ * handlers. Before waiting for input, everything drawn since previous frame is
+ * sent to the terminal as one frame, or when the frame rate cap defers it,
+ * once the loop wakes up for it (INPUT_FRAME), and board changes are sent
+ * to spectators (--broadcast). Input arrival, state transition and render
+ * completion of each cycle are timestamped for the debug panel (PERF_KEY),
+ * rendering and input reads are traced with TRACE=1.
  *
  * @note USE_MOCK used for frontend stubs for unit tests of logic
  */
@@ -72,157 +259,247 @@ void game_loop(void) {
     if (*state == GAMEOVER || *state == EXIT_ERROR) continue_flag = false;
     userInput(get_action(signal), false);
 #ifndef USE_MOCK
-    if (*state == MOVING || *state == START) signal = getch();
+    if (*state == MOVING || *state == START || *state == PAUSED) {
+      perf_transition();
+      print_perf_panel();
+      TRACE_BEGIN(TRACE_RENDER, 0);
+      broadcast_frame();
+      print_frame();
+      TRACE_END(TRACE_RENDER, 0);
+      perf_render_done();
+      TRACE_BEGIN(TRACE_INPUT, 0);
+      do {
+        signal = events_read_input(true);
+        if (signal == INPUT_RESIZE) redraw_screen();
+        if (signal == INPUT_FRAME) print_frame();
+        perf_poll_dump();
+        TRACE_POLL_EXPORT();
+      } while (signal == INPUT_NONE || signal == INPUT_RESIZE ||
+               signal == INPUT_FRAME);
+      TRACE_END(TRACE_INPUT, signal);
+      if (signal == INPUT_TERMINATE) continue_flag = false;
+      if (signal == PERF_KEY) perf_toggle();
+      perf_cycle_start(signal >= 0);
+    }
 #endif
   }
   if (*state == EXIT_ERROR) {
     print_exit_error_banner();
 #ifndef USE_MOCK
-    nodelay(stdscr, false);
-    getch();
+    print_frame();
+    events_wait_key();
 #endif
   }
 }
 
+#ifndef USE_MOCK
+/**
+ * @brief lay out panels for new terminal size and draw them from game state:
+ * the only full redraw of the screen after init
+ */
+static void redraw_screen(void) {
+  TetrisState_t state = *updateTetrisState();
+  resize_panels();
+  if (state == START)
+    print_overlay();
+  else
+    print_game_screen();
+  if (state == PAUSED) print_pause_banner();
+  print_perf_panel();
+  print_frame();
+}
+#endif
+
 /**
- * @brief initialise game structure with values, initialise field and next
- * figure (memory allocation for matrices x2). Update game info
+ * @brief initialise game state with values in arena of current game (one
+ * memory block for the whole game), seed figures random generator. Update game
+ * state and game info
  *
  * @return error code
  */
 int init_game(void) {
-  srand(
-      time(NULL)); /**< Seed random number generator for figure randomization */
+  int error = NO_ERROR;
 #ifndef USE_MOCK
   NCURSES_INIT(-1);      /**< Initialize ncurses window with default settings */
   setlocale(LC_ALL, ""); /**< Set locale for international character support */
-  print_overlay();       /**< Display initial game frame and intro message */
+  error = init_panels(); /**< Create board, stats and next figure windows */
+  if (error == NO_ERROR) error = events_init(); /**< Timer and signal fds */
+  if (error == NO_ERROR) {
+    print_overlay(); /**< Display initial game frame and intro message */
+    print_frame();
+  }
 #endif
-  int error = NO_ERROR;
-  int **figure = updateFigure();
-  if (figure == NULL) error = ERROR;
-  GameInfo_t *game = updateCurrentState();
+  GameArena_t *arena = current_arena();
+  if (arena == NULL) error = ERROR;
   TetrisState_t *state = updateTetrisState();
   *state = (error == NO_ERROR) ? START : EXIT_ERROR;
-  if (error == NO_ERROR) error = init_field(&(game->field), ROWS_MAP, COLS_MAP);
-  if (error == NO_ERROR)
-    error =
-        init_field(&(game->next), SIDE_OF_FIGURE_SQUARE, SIDE_OF_FIGURE_SQUARE);
-  game->score = 0;
-  game->level = 1;
-  game->high_score = 0;
-  game->speed = INITIAL_TIMEOUT;
-  game->pause = 0;
+  if (error == NO_ERROR) reset_game_state((uint32_t)time(NULL));
+  updateCurrentState();
   return error;
 }
 
+/**
+ * @brief clear game state of current game: level 1, seeded figures random
+ * generator. Update game state
+ * @param[in] seed seed of figures random generator
+ */
+void reset_game_state(uint32_t seed) {
+  GameState_t *st = updateGameState();
+  memset(st, 0, sizeof(*st));
+  st->seed = seed;
+  st->start_seed = seed;
+  st->level = 1;
+  set_gravity_level(st->level);
+}
+
 /**
  * @brief Frees resourses, exit ncurses,
  *
  * @note USE_MOCK used for frontend stubs for unit tests of logic
  */
 void exit_game() {
+  versus_free();    /**< Close peer sockets before event loop */
+  broadcast_free(); /**< Send last frame, close spectator sockets */
 #ifndef USE_MOCK
-  endwin(); /**< Clean up ncurses resources */
+  free_panels(); /**< Delete panel windows */
+  events_free(); /**< Close timer and signal fds, unblock signals */
+  endwin();      /**< Clean up ncurses resources */
 #endif
-  int **figure = updateFigure();
+  leaderboard_close();
   free_game();
-  free_field(figure);
+  free_arena_pool();
 }
+
 /**
- * @brief initialize matrix x 2 of rows * cols
+ * @brief take arena from pool or allocate a new cache line aligned one if pool
+ * is empty, link its row pointers and clear it
  *
- * @param[in] field pointer to matrix x 2 (int ***)
- * @param[in] rows number of rows
- * @param[in] cols number of columns
- * @return error code
+ * @return pointer to arena, NULL if allocation failed
  */
-static int init_field(int ***field, int rows, int cols) {
-  int error = ERROR;
-  *field = calloc(rows, sizeof(int *));
-  if (*field) {
-    (*field)[0] = calloc(rows * cols, sizeof(int));
-    if ((*field)[0]) {
-      error = NO_ERROR;
-      for (int i = 0; i < rows; i++) (*field)[i] = (*field)[0] + i * cols;
-    } else {
-      free(*field);
-      *field = NULL;
+static GameArena_t *acquire_arena(void) {
+  ArenaPool_t *pool = updateArenaPool();
+  GameArena_t *arena = NULL;
+  if (pool->n > 0) {
+    arena = pool->arenas[--pool->n];
+  } else {
+    arena = aligned_alloc(_Alignof(GameArena_t), sizeof(GameArena_t));
+    if (arena) {
+      for (int i = 0; i < FIELD_ROWS; i++)
+        arena->field_rows[i] = arena->state.field[i];
+      for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++) {
+        arena->next_rows[i] = arena->state.next[i];
+        arena->figure_rows[i] = arena->state.figure[i];
+      }
     }
   }
-  return error;
+  if (arena) clear_arena(arena);
+  return arena;
 }
 
 /**
- * @brief free memory allocated for matrix x 2
+ * @brief return arena to pool, free it if pool is full
  *
- * @param[in] field matrix x 2 (int **)
- * @return error code
+ * @param[in] arena pointer to arena
  */
-void free_field(int **field) {
-  if (field && field[0]) free(field[0]);
-  if (field) free(field);
+static void release_arena(GameArena_t *arena) {
+  ArenaPool_t *pool = updateArenaPool();
+  if (pool->n < ARENA_POOL_SIZE)
+    pool->arenas[pool->n++] = arena;
+  else
+    free(arena);
 }
 
 /**
- * @brief free game, free memory allocated for field and next figure. Update
- * game info
+ * @brief set whole game state of arena to 0
+ *
+ * @param[in] arena pointer to arena
+ */
+static void clear_arena(GameArena_t *arena) {
+  memset(&arena->state, 0, sizeof(arena->state));
+}
+
+/**
+ * @brief free game, return arena with game state to arena pool. Update game
+ * info
  */
 void free_game(void) {
-  GameInfo_t *game = updateCurrentState();
-  free_field(game->field);
-  free_field(game->next);
+  GameArena_t **arena = updateGameArena();
+  if (*arena) release_arena(*arena);
+  *arena = NULL;
+  updateCurrentState();
 }
 
 /**
- * @brief free game, free memory allocated for field and next figure
+ * @brief free all arenas kept in arena pool
+ */
+void free_arena_pool(void) {
+  ArenaPool_t *pool = updateArenaPool();
+  while (pool->n > 0) free(pool->arenas[--pool->n]);
+}
+
+/**
+ * @brief choose random figure and its rotation as the next figure. Update game
+ * state next figure and game context
  */
 void assign_next_figure(void) {
-  GameInfo_t *game = updateCurrentState();
-  int random = rand();
-  int rotation_n = random % 4;
-  int fig_number = random % NUMBER_OF_FIGURES;
-  figures_choice(game->next, fig_number);
-  for (int r = 0; r < rotation_n; r++) rotate_figure(game->next);
+  perf_count(PERF_ASSIGN_NEXT_FIGURE);
+  GameState_t *st = updateGameState();
+  GameContext_t *context = &st->context;
+  uint32_t random = next_random();
+  context->next_rotation = random % NUMBER_OF_ROTATIONS;
+  context->next_type = random % NUMBER_OF_FIGURES;
+  mask_to_figure(st->next,
+                 figure_masks[context->next_type][context->next_rotation]);
+}
+
+/**
+ * @brief xorshift32 random generator, its state is kept in game state, so
+ * copied game produces the same figures. Update game state
+ *
+ * @return next random number
+ */
+static uint32_t next_random(void) {
+  GameState_t *st = updateGameState();
+  uint32_t x = (st->seed) ? st->seed : 2463534242u;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  st->seed = x;
+  return x;
 }
 
 /**
- * @brief copy next figure to current figure. Update game info wit next figure
+ * @brief copy next figure to current figure. Update game state with next
+ * figure
  */
 void copy_next_figure_to_figure(void) {
-  GameInfo_t *game = updateCurrentState();
-  int **figure = updateFigure();
-  for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++)
-    for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++)
-      figure[i][j] = game->next[i][j];
+  perf_count(PERF_COPY_NEXT_FIGURE);
+  GameState_t *st = updateGameState();
+  st->context.figure_type = st->context.next_type;
+  st->context.figure_rotation = st->context.next_rotation;
+  memcpy(st->figure, st->next, sizeof(st->figure));
 }
 
 /**
- * @brief update high score in game info: read from HIGH_SCORE_FILE and
- * compare with current score. Update both game info and file
+ * @brief update high score in game state: best of leaderboard top score and
+ * current score. Maps leaderboard file on first call, then reads the mapping
+ * only. Update game state
  *
  * @return error code
  */
 int high_score_update(void) {
-  GameInfo_t *game = updateCurrentState();
+  perf_count(PERF_HIGH_SCORE_UPDATE);
+  GameState_t *game = updateGameState();
   int rc = NO_ERROR;
   if (game->high_score == 0 || game->score > game->high_score) {
-    FILE *record_note_r = fopen(HIGH_SCORE_FILE, "r+");
-    if (record_note_r) {
-      fscanf(record_note_r, "%d", &game->high_score);
-      if (game->score > game->high_score) {
-        rewind(record_note_r);
-        fprintf(record_note_r, "%d", game->score);
-        game->high_score = game->score;
-      }
-      fclose(record_note_r);
-    } else {
-      FILE *record_note_w = fopen(HIGH_SCORE_FILE, "w");
-      if (record_note_w) {
-        fprintf(record_note_w, "%d", game->score);
-        fclose(record_note_w);
-      } else
-        rc = ERROR;
+    if (updateLeaderboard()->file == NULL) {
+      TRACE_BEGIN(TRACE_HIGH_SCORE_IO, game->score);
+      rc = leaderboard_open(updateLeaderboard()->path);
+      TRACE_END(TRACE_HIGH_SCORE_IO, rc);
+    }
+    if (rc == NO_ERROR) {
+      int top = leaderboard_top_score();
+      game->high_score = (game->score > top) ? game->score : top;
     }
   }
   return rc;
@@ -230,64 +507,78 @@ int high_score_update(void) {
 
 /**
  * @brief initialize start figure position to attach to the middle of "ceiling"
- * of field. Update figure position.
+ * of field, rows above lowest figure row go to the hidden buffer. Update
+ * figure position.
  */
 void init_figure_position(void) {
-  int **figure = updateFigure();
+  perf_count(PERF_INIT_FIGURE_POSITION);
+  GameContext_t *context = updateGameContext();
   FigurePos_t *fig_pos = updateFigurePosition();
-  fig_pos->x = FIGURESTART_X;
-  fig_pos->y = FIGURESTART_Y;
-  for (int i = 0, sum = 0; sum == 0 && i < SIDE_OF_FIGURE_SQUARE; i++) {
-    for (int j = 0; sum == 0 && j < SIDE_OF_FIGURE_SQUARE; j++)
-      sum += figure[i][j];
-    if (sum == 0) fig_pos->y--;
-  }
-  for (int i = 0, sum = 0; sum == 0 && i < SIDE_OF_FIGURE_SQUARE; i++) {
-    for (int j = 0; sum == 0 && j < SIDE_OF_FIGURE_SQUARE; j++)
-      sum += figure[j][i];
-    if (sum == 0) fig_pos->x--;
-  }
+  const int8_t *offset =
+      figure_spawn_offsets[context->figure_type][context->figure_rotation];
+  fig_pos->x = FIGURESTART_X - offset[0];
+  fig_pos->y = FIGURESTART_Y - offset[1];
 }
 
 /**
  * @brief check if some rows are finished. Call their destruction and shift
- * field down. Update game info field
+ * field down. Update game state field
  *
  * @return amount of finished rows
  */
 int destruction_of_rows(void) {
-  GameInfo_t *game = updateCurrentState();
+  perf_count(PERF_DESTRUCTION_OF_ROWS);
+  GameState_t *st = updateGameState();
   int n_rows = 0;
-  for (int i = 0; i < ROWS_MAP; i++)
-    if (check_finished_row(game->field[i])) {
+  for (int i = 0; i < FIELD_ROWS; i++)
+    if (check_finished_row(st->field[i])) {
       n_rows++;
-      shift_rows_down(i);
+      shift_rows_down(i - HIDDEN_ROWS);
     }
   return n_rows;
 }
 
 /**
- * @brief check if the row is finished
- * @param[in] row pointer to row of matrix (int *)
- * @return amount of finished rows
+ * @brief push field up by rows and fill bottom rows with garbage: filled rows
+ * with an empty cell in one random column. Update game state field
+ * @param[in] rows number of garbage rows
+ */
+void insert_garbage_rows(int rows) {
+  GameState_t *st = updateGameState();
+  if (rows > FIELD_ROWS) rows = FIELD_ROWS;
+  if (rows > 0) {
+    int hole = next_random() % COLS_MAP;
+    memmove(st->field[0], st->field[rows],
+            (FIELD_ROWS - rows) * sizeof(st->field[0]));
+    for (int i = FIELD_ROWS - rows; i < FIELD_ROWS; i++)
+      for (int j = 0; j < COLS_MAP; j++)
+        st->field[i][j] = (j == hole) ? EMPTY_CELL : GARBAGE_CELL;
+  }
+}
+
+/**
+ * @brief check if the row is finished: collect filled cells to row mask
+ * without branches and compare it with full row mask
+ * @param[in] row pointer to row of field (cell_t *)
+ * @return 1 if row is finished, 0 otherwise
  */
-static int check_finished_row(int const *row) {
-  int finished_row = 1;
-  for (int j = 0; finished_row == 1 && j < COLS_MAP; j++)
-    if (row[j] != 1) finished_row = 0;
-  return finished_row;
+static int check_finished_row(cell_t const *row) {
+  row_mask_t mask = 0;
+  for (int j = 0; j < COLS_MAP; j++)
+    mask |= (row_mask_t)CELL_FILLED(row[j]) << j;
+  return mask == FULL_ROW_MASK;
 }
 
 /**
- * @brief aemove finished row: shifts all upper rows down. Update game info
+ * @brief aemove finished row: shifts all upper rows down. Update game state
  * field
- * @param[in] row number of row
+ * @param[in] row number of row (negative for hidden rows)
  */
 static void shift_rows_down(int row) {
-  GameInfo_t *game = updateCurrentState();
-  for (int i = row; i >= 0; i--) {
+  cell_t(*field)[COLS_MAP] = updateGameState()->field + HIDDEN_ROWS;
+  for (int i = row; i >= -HIDDEN_ROWS; i--) {
     for (int j = 0; j < COLS_MAP; j++)
-      game->field[i][j] = (i > 0) ? game->field[i - 1][j] : 0;
+      field[i][j] = (i > -HIDDEN_ROWS) ? field[i - 1][j] : EMPTY_CELL;
   }
 }
 
@@ -298,17 +589,19 @@ static void shift_rows_down(int row) {
  * @return error code
  */
 int check_collide(void) {
-  GameInfo_t *game = updateCurrentState();
-  FigurePos_t *fig_pos = updateFigurePosition();
-  int **figure = updateFigure();
+  perf_count(PERF_CHECK_COLLIDE);
+  GameState_t *st = updateGameState();
+  cell_t(*field)[COLS_MAP] = st->field + HIDDEN_ROWS;
+  FigurePos_t *fig_pos = &st->figure_pos;
+  int(*figure)[SIDE_OF_FIGURE_SQUARE] = st->figure;
   int rc = false;
   for (int i = 0; rc == false && i < SIDE_OF_FIGURE_SQUARE; i++)
     for (int j = 0; rc == false && j < SIDE_OF_FIGURE_SQUARE; j++)
       if (figure[i][j] == 1) {
         int y = fig_pos->y + i;
         int x = fig_pos->x + j;
-        if (x < 0 || y < 0 || x >= COLS_MAP || y >= ROWS_MAP ||
-            game->field[y][x] == 1) {
+        if (x < 0 || y < -HIDDEN_ROWS || x >= COLS_MAP || y >= ROWS_MAP ||
+            CELL_FILLED(field[y][x])) {
           rc = true;
         }
       }
@@ -316,22 +609,236 @@ int check_collide(void) {
 }
 
 /**
- * @brief update game info score and increments speed based on number of rows
- * finished and destroyed
+ * @brief check if figure mask placed on certain coordinates collides with
+ * field or borders. Walks only filled cells of the mask
+ * @param[in] mask figure mask (bit i * 4 + j is cell of row i, column j)
+ * @param[in] x X coordinate of figure matrix on the field
+ * @param[in] y Y coordinate of figure matrix on the field
+ *
+ * @return collision status
+ */
+static int check_collide_mask(unsigned mask, int x, int y) {
+  cell_t(*field)[COLS_MAP] = updateGameState()->field + HIDDEN_ROWS;
+  int rc = false;
+  for (; rc == false && mask; mask &= mask - 1) {
+    int bit = __builtin_ctz(mask);
+    int row = y + bit / SIDE_OF_FIGURE_SQUARE;
+    int col = x + bit % SIDE_OF_FIGURE_SQUARE;
+    if (col < 0 || row < -HIDDEN_ROWS || col >= COLS_MAP || row >= ROWS_MAP ||
+        CELL_FILLED(field[row][col]))
+      rc = true;
+  }
+  return rc;
+}
+
+/**
+ * @brief compute free rows under the figure: for every figure column scan
+ * field down from the lowest figure cell of this column
+ *
+ * @return number of rows figure can fall
+ */
+int drop_distance(void) {
+  perf_count(PERF_DROP_DISTANCE);
+  GameState_t *st = updateGameState();
+  cell_t(*field)[COLS_MAP] = st->field + HIDDEN_ROWS;
+  FigurePos_t *fig_pos = &st->figure_pos;
+  int(*figure)[SIDE_OF_FIGURE_SQUARE] = st->figure;
+  int distance = ROWS_MAP;
+  for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++) {
+    int bottom = -1;
+    for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++)
+      if (figure[i][j] == 1) bottom = i;
+    if (bottom >= 0) {
+      int x = fig_pos->x + j;
+      int y = fig_pos->y + bottom + 1;
+      int d = 0;
+      while (d < distance && y + d < ROWS_MAP && !CELL_FILLED(field[y + d][x]))
+        d++;
+      distance = d;
+    }
+  }
+  return distance;
+}
+
+/**
+ * @brief add gravity of one tick to accumulated fraction of a row. Update
+ * game context
+ *
+ * @return whole rows to fall on this tick
+ */
+int gravity_rows(void) {
+  perf_count(PERF_GRAVITY_ROWS);
+  GameContext_t *context = updateGameContext();
+  context->gravity_acc += context->gravity;
+  int rows = context->gravity_acc / GRAVITY_UNIT;
+  context->gravity_acc %= GRAVITY_UNIT;
+  return rows;
+}
+
+/**
+ * @brief read monotonic clock, not affected by system time changes
+ *
+ * @return time in milliseconds
+ */
+int64_t monotonic_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief read monotonic clock with full resolution
+ *
+ * @return time in nanoseconds
+ */
+int64_t monotonic_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief time played in current game: since start, time in pause excluded
+ *
+ * @return time in milliseconds, 0 if game has not started
+ */
+int64_t play_time_ms(void) {
+  GameState_t *st = updateGameState();
+  int64_t now = (st->pause) ? st->context.pause_start : monotonic_ms();
+  return (st->context.start_ms > 0) ? now - st->context.start_ms : 0;
+}
+
+/**
+ * @brief keep static clock override of lock delay, negative - none
+ *
+ * @return pointer to clock override (ms)
+ */
+static int64_t *updateGameClock(void) {
+  static int64_t clock = -1;
+  return &clock;
+}
+
+/**
+ * @brief read clock of lock delay: simulated time if it is set, monotonic
+ * clock otherwise
+ *
+ * @return time in milliseconds
+ */
+int64_t game_clock_ms(void) {
+  int64_t clock = *updateGameClock();
+  return (clock >= 0) ? clock : monotonic_ms();
+}
+
+/**
+ * @brief set simulated time of lock delay. Update clock override
+ * @param[in] ms simulated time (ms), negative - use monotonic clock
+ */
+void set_game_clock(int64_t ms) { *updateGameClock() = ms; }
+
+/**
+ * @brief reset lock delay for spawned figure. Update game context
+ */
+void lock_delay_reset(void) {
+  GameContext_t *context = updateGameContext();
+  context->lock_active = false;
+  context->lock_resets = 0;
+  context->lowest_y = updateFigurePosition()->y;
+}
+
+/**
+ * @brief figure fell by one row: it is not grounded anymore, new lowest row
+ * gives back all lock delay restarts. Update game context
+ */
+void lock_delay_on_fall(void) {
+  GameContext_t *context = updateGameContext();
+  FigurePos_t *fig_pos = updateFigurePosition();
+  context->lock_active = false;
+  if (fig_pos->y > context->lowest_y) {
+    context->lowest_y = fig_pos->y;
+    context->lock_resets = 0;
+  }
+}
+
+/**
+ * @brief restart lock delay of grounded figure after move or rotation while
+ * restarts are left. Update game context
+ */
+void lock_delay_on_move(void) {
+  GameContext_t *context = updateGameContext();
+  if (context->lock_active && context->lock_resets < LOCK_MOVE_RESETS) {
+    context->lock_start = game_clock_ms();
+    context->lock_resets++;
+  }
+}
+
+/**
+ * @brief start lock delay already expired. Update game context
+ */
+void lock_delay_force(void) {
+  GameContext_t *context = updateGameContext();
+  context->lock_active = true;
+  context->lock_start = game_clock_ms() - LOCK_DELAY_MS;
+}
+
+/**
+ * @brief check if grounded figure must lock. Starts lock delay on first
+ * grounded check. Update game context
+ *
+ * @return 1 if lock delay is over, 0 otherwise
+ */
+int lock_delay_expired(void) {
+  GameContext_t *context = updateGameContext();
+  if (!context->lock_active) {
+    context->lock_active = true;
+    context->lock_start = game_clock_ms();
+  }
+  return lock_delay_remaining() == 0;
+}
+
+/**
+ * @brief time left until grounded figure locks
+ *
+ * @return milliseconds left, 0 if lock delay is over
+ */
+int lock_delay_remaining(void) {
+  GameContext_t *context = updateGameContext();
+  int64_t left = context->lock_start + LOCK_DELAY_MS - game_clock_ms();
+  return (left > 0) ? (int)left : 0;
+}
+
+/**
+ * @brief update game state score, level, speed and gravity based on number of
+ * rows finished and destroyed
  * @param[in] n_rows amount of rows
  */
 void recalculate_stats(int n_rows) {
-  GameInfo_t *game = updateCurrentState();
+  perf_count(PERF_RECALCULATE_STATS);
+  GameState_t *game = updateGameState();
   if (n_rows) {
     if (n_rows == 1) game->score += 100;
     if (n_rows == 2) game->score += 300;
     if (n_rows == 3) game->score += 700;
     if (n_rows == 4) game->score += 1500;
+    game->lines += n_rows;
+    if (n_rows <= 4) game->clears[n_rows - 1]++;
     game->level = 1 + game->score / 600;
-    game->speed = INITIAL_TIMEOUT - (game->level - 1) * SPEED_DECREMENT;
+    set_gravity_level(game->level);
   }
 }
 
+/**
+ * @brief set speed and gravity of level from gravity table. Update game state
+ * speed and game context gravity
+ * @param[in] level game level (from 1)
+ */
+static void set_gravity_level(int level) {
+  int last = sizeof(gravity_table) / sizeof(gravity_table[0]) - 1;
+  int n = (level - 1 < last) ? level - 1 : last;
+  GameState_t *st = updateGameState();
+  st->speed = gravity_table[n].speed;
+  st->context.gravity = gravity_table[n].gravity;
+}
+
 /**
  * @brief rotate figure clockwise, updates static figure
  * @param[in] figure pointer to figure matrix (int **)
@@ -347,39 +854,111 @@ void rotate_figure(int **figure) {
 }
 
 /**
- * @brief add 1 values of figure matrix on certain coordinates to field matrix 1
- * values. Update game info field
+ * @brief rotate current figure to the next rotation state. On collision tries
+ * kick offsets of the figure kick table in order, first free position wins.
+ * Updates figure, figure position and game context only on success
+ *
+ * @return 1 if figure was rotated, 0 otherwise
  */
-void attach_figure_to_field(void) {
-  int **figure = updateFigure();
-  GameInfo_t *game = updateCurrentState();
+int rotate_figure_with_kicks(void) {
+  perf_count(PERF_ROTATE_WITH_KICKS);
+  GameContext_t *context = updateGameContext();
   FigurePos_t *fig_pos = updateFigurePosition();
+  int from = context->figure_rotation;
+  int to = (from + 1) % NUMBER_OF_ROTATIONS;
+  unsigned mask = figure_masks[context->figure_type][to];
+  const int8_t(*kicks)[2] =
+      figure_kicks[figure_kick_table[context->figure_type]][from];
+  int rotated = false;
+  for (int k = 0; rotated == false && k < NUMBER_OF_KICKS; k++) {
+    int x = fig_pos->x + kicks[k][0];
+    int y = fig_pos->y + kicks[k][1];
+    if (!check_collide_mask(mask, x, y)) {
+      fig_pos->x = x;
+      fig_pos->y = y;
+      context->figure_rotation = to;
+      mask_to_figure(updateGameState()->figure, mask);
+      rotated = true;
+    }
+  }
+  return rotated;
+}
+
+/**
+ * @brief check if the lowest figure row is above the top visible row
+ *
+ * @return 1 if figure is entirely in hidden buffer, 0 otherwise
+ */
+int check_lock_out(void) {
+  perf_count(PERF_CHECK_LOCK_OUT);
+  GameState_t *st = updateGameState();
+  int(*figure)[SIDE_OF_FIGURE_SQUARE] = st->figure;
+  FigurePos_t *fig_pos = &st->figure_pos;
+  int bottom = -1;
+  for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++)
+    for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++)
+      if (figure[i][j] == 1) bottom = i;
+  return bottom >= 0 && fig_pos->y + bottom < 0;
+}
+
+/**
+ * @brief add 1 values of figure matrix on certain coordinates to field matrix
+ * as piece id of the figure. Update game state field
+ */
+void attach_figure_to_field(void) {
+  perf_count(PERF_ATTACH_FIGURE);
+  GameState_t *st = updateGameState();
+  cell_t(*field)[COLS_MAP] = st->field + HIDDEN_ROWS;
+  int(*figure)[SIDE_OF_FIGURE_SQUARE] = st->figure;
+  FigurePos_t *fig_pos = &st->figure_pos;
+  cell_t piece = PIECE_ID(st->context.figure_type);
   for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++) {
     for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++) {
       int y = fig_pos->y + i;
       int x = fig_pos->x + j;
-      if (figure[i][j]) game->field[y][x] = 1;
+      if (figure[i][j]) field[y][x] = piece;
     }
   }
 }
 
 /**
- * @brief array[amount of figures][rows][cols] of available figures. Assign n-th
- * figure from array to figure
- * @param[in] figure pointer to figure matrix (int **)
- * @param[in] n number of figure
- */
-static void figures_choice(int **figure, int n) {
-  int all_figures[NUMBER_OF_FIGURES][SIDE_OF_FIGURE_SQUARE]
-                 [SIDE_OF_FIGURE_SQUARE] = {
-                     {{0, 0, 0, 0}, {1, 1, 1, 1}, {0, 0, 0, 0}, {0, 0, 0, 0}},
-                     {{0, 0, 0, 0}, {0, 1, 1, 0}, {0, 1, 1, 0}, {0, 0, 0, 0}},
-                     {{0, 0, 0, 0}, {1, 0, 0, 0}, {1, 1, 1, 0}, {0, 0, 0, 0}},
-                     {{0, 0, 0, 0}, {0, 0, 1, 0}, {1, 1, 1, 0}, {0, 0, 0, 0}},
-                     {{0, 0, 0, 0}, {1, 1, 0, 0}, {0, 1, 1, 0}, {0, 0, 0, 0}},
-                     {{0, 0, 0, 0}, {0, 1, 1, 0}, {1, 1, 0, 0}, {0, 0, 0, 0}},
-                     {{0, 0, 0, 0}, {0, 1, 0, 0}, {1, 1, 1, 0}, {0, 0, 0, 0}}};
+ * @brief expand figure mask to figure matrix
+ * @param[in] figure figure matrix of game state
+ * @param[in] mask figure mask (bit i * 4 + j is cell of row i, column j)
+ */
+static void mask_to_figure(int (*figure)[SIDE_OF_FIGURE_SQUARE],
+                           unsigned mask) {
   for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++)
     for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++)
-      figure[i][j] = all_figures[n][i][j];
+      figure[i][j] = (mask >> (i * SIDE_OF_FIGURE_SQUARE + j)) & 1;
+}
+
+/**
+ * @brief compute screen positions of panels centered in the terminal part
+ * covered by the screen buffer: a terminal larger than the buffer would center
+ * panels partly or fully outside of it
+ * @param[out] layout layout to fill
+ * @param[in] lines terminal rows, 0 - unknown: panels start at BOARDS_BEGIN
+ * @param[in] cols terminal columns, 0 - unknown
+ * @param[in] max_lines rows of the screen buffer, 0 or less - no limit
+ * @param[in] max_cols columns of the screen buffer, 0 or less - no limit
+ */
+void compute_layout(Layout_t *layout, int lines, int cols, int max_lines,
+                    int max_cols) {
+  int y = BOARDS_BEGIN, x = BOARDS_BEGIN;
+  if (max_lines > 0 && lines > max_lines) lines = max_lines;
+  if (max_cols > 0 && cols > max_cols) cols = max_cols;
+  if (lines > 0 && cols > 0) {
+    y = (lines > LAYOUT_H) ? (lines - LAYOUT_H) / 2 : 0;
+    x = (cols > LAYOUT_W) ? (cols - LAYOUT_W) / 2 : 0;
+  }
+  layout->lines = lines;
+  layout->cols = cols;
+  layout->board_y = y;
+  layout->board_x = x;
+  layout->panel_x = x + BOARD_WIN_W;
+  layout->next_y = y + STATS_WIN_H;
+  layout->perf_y = y + BOARD_WIN_H;
+  layout->fits = lines == 0 || (lines >= LAYOUT_H && cols >= LAYOUT_W);
+  layout->generation++;
 }
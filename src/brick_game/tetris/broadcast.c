@@ -0,0 +1,208 @@
+/**
+ * @file broadcast.c
+ * @brief Spectator broadcast of board deltas over a Unix domain socket
+ * @details This file implements listening socket for spectators watched by
+ * the event loop, delta encoding of board frames and their non-blocking
+ * delivery with static object of broadcast state.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../../include/tetris.h"
+
+static void current_board(cell_t (*board)[COLS_MAP]);
+static int encode_cell(uint8_t *buf, int n, int row, int col, cell_t cell);
+static void encode_header(uint8_t *buf, char type, int n, uint32_t frame);
+static int send_message(int fd, uint8_t const *buf, int len);
+static void drop_client(Broadcast_t *bc, int i);
+
+/**
+ * @brief Keeps static object: broadcast state
+ *
+ * @return Pointer to broadcast state
+ */
+Broadcast_t *updateBroadcast(void) {
+  static Broadcast_t bc = {.listen_fd = -1};
+  return &bc;
+}
+
+/**
+ * @brief listen on socket path for spectators, stale socket path is
+ * replaced. Update broadcast state
+ * @param[in] path socket path
+ * @return error code
+ */
+int broadcast_init(char const *path) {
+  Broadcast_t *bc = updateBroadcast();
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  int error = ERROR;
+  *bc = (Broadcast_t){.listen_fd = -1};
+  if (strlen(path) < sizeof(bc->path) && strlen(path) < sizeof(addr.sun_path)) {
+    strcpy(bc->path, path);
+    strcpy(addr.sun_path, path);
+    signal(SIGPIPE, SIG_IGN); /**< Closed spectator is reported by write */
+    unlink(path);
+    bc->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (bc->listen_fd >= 0 &&
+        bind(bc->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 &&
+        listen(bc->listen_fd, SOMAXCONN) == 0) {
+      fcntl(bc->listen_fd, F_SETFL, O_NONBLOCK);
+      error = events_watch(bc->listen_fd, broadcast_on_ready);
+    }
+  }
+  bc->active = (error == NO_ERROR);
+  if (error) broadcast_free();
+  return error;
+}
+
+/**
+ * @brief send last frame, close spectator and listening sockets, remove
+ * socket path. Update broadcast state
+ */
+void broadcast_free(void) {
+  Broadcast_t *bc = updateBroadcast();
+  if (bc->active) broadcast_frame();
+  while (bc->n_clients > 0) drop_client(bc, bc->n_clients - 1);
+  if (bc->listen_fd >= 0) {
+    events_unwatch(bc->listen_fd);
+    close(bc->listen_fd);
+    unlink(bc->path);
+  }
+  *bc = (Broadcast_t){.listen_fd = -1};
+}
+
+/**
+ * @brief accept all waiting spectators, send each one key frame of the board
+ * as of the last frame sent. Update broadcast state
+ * @param[in] fd listening socket
+ * @return INPUT_NONE
+ */
+int broadcast_on_ready(int fd) {
+  Broadcast_t *bc = updateBroadcast();
+  static uint8_t buf[BROADCAST_MSG_MAX];
+  int client = -1;
+  while ((client = accept(fd, NULL, NULL)) >= 0) {
+    int len = BROADCAST_HEADER_SIZE;
+    fcntl(client, F_SETFL, O_NONBLOCK);
+    for (int i = 0; i < ROWS_MAP; i++)
+      for (int j = 0; j < COLS_MAP; j++)
+        len = encode_cell(buf, len, i, j, bc->shown[i][j]);
+    encode_header(buf, 'K', ROWS_MAP * COLS_MAP, bc->frame);
+    if (bc->n_clients < BROADCAST_MAX_CLIENTS && send_message(client, buf, len))
+      bc->clients[bc->n_clients++] = client;
+    else
+      close(client);
+  }
+  return INPUT_NONE;
+}
+
+/**
+ * @brief encode cells of the board changed since previous frame once and
+ * write the message to every spectator, drop spectators that cannot take it
+ * whole. Update broadcast state
+ */
+void broadcast_frame(void) {
+  Broadcast_t *bc = updateBroadcast();
+  static uint8_t buf[BROADCAST_MSG_MAX];
+  if (bc->n_clients > 0) {
+    cell_t board[ROWS_MAP][COLS_MAP];
+    int len = BROADCAST_HEADER_SIZE;
+    current_board(board);
+    for (int i = 0; i < ROWS_MAP; i++)
+      if (memcmp(board[i], bc->shown[i], COLS_MAP))
+        for (int j = 0; j < COLS_MAP; j++)
+          if (board[i][j] != bc->shown[i][j])
+            len = encode_cell(buf, len, i, j, board[i][j]);
+    if (len > BROADCAST_HEADER_SIZE) {
+      memcpy(bc->shown, board, sizeof(board));
+      encode_header(buf, 'D',
+                    (len - BROADCAST_HEADER_SIZE) / BROADCAST_CELL_SIZE,
+                    ++bc->frame);
+      for (int i = bc->n_clients - 1; i >= 0; i--)
+        if (!send_message(bc->clients[i], buf, len)) {
+          drop_client(bc, i);
+          bc->dropped++;
+        }
+    }
+  }
+}
+
+/**
+ * @brief board as drawn by print_board(): visible field with current figure
+ * @param[out] board board cells
+ */
+static void current_board(cell_t (*board)[COLS_MAP]) {
+  GameState_t *st = updateGameState();
+  FigurePos_t pos = st->figure_pos;
+  memcpy(board, st->field[HIDDEN_ROWS], sizeof(cell_t) * ROWS_MAP * COLS_MAP);
+  for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++)
+    for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++) {
+      int y = pos.y + i;
+      int x = pos.x + j;
+      if (st->figure[i][j] && y >= 0 && y < ROWS_MAP && x >= 0 && x < COLS_MAP)
+        board[y][x] = PIECE_ID(st->context.figure_type);
+    }
+}
+
+/**
+ * @brief append cell to message
+ * @param[out] buf message
+ * @param[in] n message length
+ * @param[in] row cell row
+ * @param[in] col cell column
+ * @param[in] cell cell value
+ * @return new message length
+ */
+static int encode_cell(uint8_t *buf, int n, int row, int col, cell_t cell) {
+  buf[n] = (uint8_t)row;
+  buf[n + 1] = (uint8_t)col;
+  buf[n + 2] = cell;
+  return n + BROADCAST_CELL_SIZE;
+}
+
+/**
+ * @brief write message header: type, board columns, number of cells and
+ * frame number, little-endian
+ * @param[out] buf message
+ * @param[in] type 'K' - key frame, 'D' - delta
+ * @param[in] n number of cells
+ * @param[in] frame frame number
+ */
+static void encode_header(uint8_t *buf, char type, int n, uint32_t frame) {
+  buf[0] = (uint8_t)type;
+  buf[1] = COLS_MAP;
+  buf[2] = (uint8_t)n;
+  buf[3] = (uint8_t)(n >> 8);
+  for (int i = 0; i < 4; i++) buf[4 + i] = (uint8_t)(frame >> (8 * i));
+}
+
+/**
+ * @brief write whole message to spectator without blocking
+ * @param[in] fd spectator socket
+ * @param[in] buf message
+ * @param[in] len message length
+ * @return 1 if the message was taken whole, 0 if spectator is closed or too
+ * slow (its stream is broken then)
+ */
+static int send_message(int fd, uint8_t const *buf, int len) {
+  return write(fd, buf, len) == len;
+}
+
+/**
+ * @brief close spectator socket, last spectator takes its slot. Update
+ * broadcast state
+ * @param[in] i spectator index
+ */
+static void drop_client(Broadcast_t *bc, int i) {
+  close(bc->clients[i]);
+  bc->clients[i] = bc->clients[--bc->n_clients];
+}
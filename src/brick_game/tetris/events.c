@@ -0,0 +1,362 @@
+/**
+ * @file events.c
+ * @brief Event loop of the game: input, game timer and signals
+ * @details This file implements poll(2) based event loop with static object of
+ * watched descriptors: stdin, timerfd of the game tick and signalfd, or the
+ * poll timeout and a self-pipe where timerfd and signalfd are not available.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#endif
+
+#include "../../include/tetris.h"
+
+/**
+ * @brief Slots of event loop descriptors, watched ones follow them
+ */
+enum { EVENT_SLOT_STDIN = 0, EVENT_SLOT_TIMER, EVENT_SLOT_SIGNALS };
+
+static void signal_mask(sigset_t *mask);
+static int timer_expired(EventLoop_t *loop);
+static EventType_t read_signal(EventLoop_t *loop);
+static int read_key(EventLoop_t *loop);
+static EventHandler_t handler_of(EventLoop_t *loop, int fd);
+#ifndef __linux__
+static void on_loop_signal(int sig);
+#endif
+
+/**
+ * @brief Keeps static object: event loop
+ *
+ * @return Pointer to event loop
+ */
+EventLoop_t *updateEventLoop(void) {
+  static EventLoop_t loop = {.timer_ms = -1, .signal_pipe = -1};
+  return &loop;
+}
+
+/**
+ * @brief create timer and signal descriptors, block loop signals, switch input
+ * to non-blocking. Update event loop
+ * @return error code
+ *
+ * @note USE_MOCK used for frontend stubs for unit tests of logic
+ */
+int events_init(void) {
+  EventLoop_t *loop = updateEventLoop();
+  sigset_t mask;
+  signal_mask(&mask);
+  *loop = (EventLoop_t){.timer_ms = -1, .signal_pipe = -1};
+#ifdef __linux__
+  int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  int signals = -1;
+  if (timer >= 0 && sigprocmask(SIG_BLOCK, &mask, NULL) == 0)
+    signals = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+#else
+  int timer = -1;
+  int signals = -1;
+  int p[2];
+  if (pipe(p) == 0) {
+    fcntl(p[0], F_SETFL, O_NONBLOCK);
+    fcntl(p[1], F_SETFL, O_NONBLOCK);
+    signals = p[0];
+    loop->signal_pipe = p[1];
+    struct sigaction sa = {0};
+    sa.sa_handler = on_loop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGWINCH, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+  }
+#endif
+  loop->fds[EVENT_SLOT_STDIN] = (struct pollfd){STDIN_FILENO, POLLIN, 0};
+  loop->fds[EVENT_SLOT_TIMER] = (struct pollfd){timer, POLLIN, 0};
+  loop->fds[EVENT_SLOT_SIGNALS] = (struct pollfd){signals, POLLIN, 0};
+  loop->nfds = EVENT_SLOT_SIGNALS + 1;
+  int error = (signals >= 0) ? NO_ERROR : ERROR;
+  if (error) events_free();
+#ifndef USE_MOCK
+  nodelay(stdscr, TRUE); /**< Keys are read only when poll reports them */
+#endif
+  return error;
+}
+
+/**
+ * @brief close timer and signal descriptors, unblock loop signals. Update
+ * event loop
+ */
+void events_free(void) {
+  EventLoop_t *loop = updateEventLoop();
+  sigset_t mask;
+  signal_mask(&mask);
+  if (loop->nfds) {
+    if (loop->fds[EVENT_SLOT_TIMER].fd >= 0)
+      close(loop->fds[EVENT_SLOT_TIMER].fd);
+    if (loop->fds[EVENT_SLOT_SIGNALS].fd >= 0)
+      close(loop->fds[EVENT_SLOT_SIGNALS].fd);
+#ifdef __linux__
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+#else
+    signal(SIGWINCH, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+    if (loop->signal_pipe >= 0) close(loop->signal_pipe);
+#endif
+  }
+  *loop = (EventLoop_t){.timer_ms = -1, .signal_pipe = -1};
+}
+
+/**
+ * @brief arm periodic game timer, first tick in ms from now. Update event loop
+ * @param[in] ms period (ms), negative - disarm
+ */
+void events_set_timer(int ms) {
+  EventLoop_t *loop = updateEventLoop();
+  loop->timer_ms = ms;
+  loop->deadline = monotonic_ms() + ms;
+#ifdef __linux__
+  struct itimerspec its = {0};
+  if (ms >= 0) {
+    int period = (ms > 0) ? ms : 1;
+    its.it_interval.tv_sec = period / 1000;
+    its.it_interval.tv_nsec = (long)(period % 1000) * 1000000;
+    its.it_value = its.it_interval;
+    if (ms == 0) its.it_value = (struct timespec){0, 1};
+  }
+  if (loop->nfds)
+    timerfd_settime(loop->fds[EVENT_SLOT_TIMER].fd, 0, &its, NULL);
+#endif
+}
+
+/**
+ * @brief set time of deferred frame, poll timeout wakes the loop then. Update
+ * event loop
+ * @param[in] at monotonic ms, 0 - no deferred frame
+ */
+void events_defer_frame(int64_t at) { updateEventLoop()->frame_at = at; }
+
+/**
+ * @brief add descriptor to watched ones. Update event loop
+ * @param[in] fd descriptor
+ * @param[in] handler handler of readable fd, may be NULL
+ * @return error code
+ */
+int events_watch(int fd, EventHandler_t handler) {
+  EventLoop_t *loop = updateEventLoop();
+  int error = ERROR;
+  if (loop->nfds && loop->nfds < EVENT_MAX_FDS) {
+    loop->handlers[loop->nfds] = handler;
+    loop->fds[loop->nfds++] = (struct pollfd){fd, POLLIN, 0};
+    error = NO_ERROR;
+  }
+  return error;
+}
+
+/**
+ * @brief remove descriptor from watched ones. Update event loop
+ * @param[in] fd descriptor
+ */
+void events_unwatch(int fd) {
+  EventLoop_t *loop = updateEventLoop();
+  for (int i = EVENT_SLOT_SIGNALS + 1; i < loop->nfds; i++)
+    if (loop->fds[i].fd == fd) {
+      loop->nfds--;
+      loop->fds[i] = loop->fds[loop->nfds];
+      loop->handlers[i--] = loop->handlers[loop->nfds];
+    }
+}
+
+/**
+ * @brief sleep in poll until a descriptor is ready, the tick comes or the
+ * deferred frame is due, take one event: signals first, then timer, input,
+ * watched descriptors and deferred frame
+ * @return event, EVENT_TERMINATE if loop is not created
+ */
+Event_t events_wait(void) {
+  EventLoop_t *loop = updateEventLoop();
+  Event_t ev = {(loop->nfds) ? EVENT_NONE : EVENT_TERMINATE, -1};
+  int64_t wake = (loop->frame_at > 0) ? loop->frame_at : -1;
+  int timeout = -1;
+#ifndef __linux__
+  if (loop->timer_ms >= 0 && (wake < 0 || loop->deadline < wake))
+    wake = loop->deadline;
+#endif
+  if (wake >= 0) {
+    int64_t left = wake - monotonic_ms();
+    timeout = (left > 0) ? (int)left : 0;
+  }
+  if (loop->nfds && poll(loop->fds, loop->nfds, timeout) >= 0) {
+    short in = loop->fds[EVENT_SLOT_STDIN].revents;
+    if (loop->fds[EVENT_SLOT_SIGNALS].revents & POLLIN) {
+      ev.type = read_signal(loop);
+    } else if (timer_expired(loop)) {
+      ev.type = EVENT_TIMER;
+    } else if (in & (POLLHUP | POLLERR | POLLNVAL)) {
+      ev.type = EVENT_TERMINATE;
+    } else if (in & POLLIN) {
+      ev.type = EVENT_INPUT;
+    } else {
+      for (int i = EVENT_SLOT_SIGNALS + 1; i < loop->nfds && !ev.type; i++)
+        if (loop->fds[i].revents) ev = (Event_t){EVENT_FD, loop->fds[i].fd};
+    }
+    if (!ev.type && loop->frame_at > 0 && monotonic_ms() >= loop->frame_at) {
+      ev.type = EVENT_FRAME;
+      loop->frame_at = 0;
+    }
+  }
+  return ev;
+}
+
+/**
+ * @brief wait for next event and turn it into input of the state machine. Keys
+ * buffered by the terminal layer are taken before sleeping again, readable
+ * watched descriptors are passed to their handlers
+ * @param[in] ticks true - return timer events as INPUT_TICK
+ * @return key, INPUT_TICK, INPUT_TERMINATE, INPUT_RESIZE, INPUT_FRAME or
+ * INPUT_NONE
+ */
+int events_read_input(bool ticks) {
+  EventLoop_t *loop = updateEventLoop();
+  int signal = (loop->input_pending) ? read_key(loop) : INPUT_NONE;
+  if (signal == INPUT_NONE) {
+    Event_t ev = events_wait();
+    if (ev.type == EVENT_INPUT)
+      signal = read_key(loop);
+    else if (ev.type == EVENT_TIMER && ticks)
+      signal = INPUT_TICK;
+    else if (ev.type == EVENT_TERMINATE)
+      signal = INPUT_TERMINATE;
+    else if (ev.type == EVENT_RESIZE)
+      signal = INPUT_RESIZE;
+    else if (ev.type == EVENT_FRAME)
+      signal = INPUT_FRAME;
+    else if (ev.type == EVENT_FD && handler_of(loop, ev.fd))
+      signal = handler_of(loop, ev.fd)(ev.fd);
+  }
+  return signal;
+}
+
+/**
+ * @brief wait for a key ignoring timer, resize and other events, send deferred
+ * frame when it is due
+ * @return key or INPUT_TERMINATE
+ *
+ * @note USE_MOCK used for frontend stubs for unit tests of logic
+ */
+int events_wait_key(void) {
+  int signal = INPUT_NONE;
+  while (signal == INPUT_NONE || signal == INPUT_RESIZE ||
+         signal == INPUT_FRAME) {
+    signal = events_read_input(false);
+#ifndef USE_MOCK
+    if (signal == INPUT_FRAME) print_frame();
+#endif
+  }
+  return signal;
+}
+
+/**
+ * @brief signals delivered through event loop: SIGWINCH, SIGTERM, SIGINT
+ * @param[out] mask signal set
+ */
+static void signal_mask(sigset_t *mask) {
+  sigemptyset(mask);
+  sigaddset(mask, SIGWINCH);
+  sigaddset(mask, SIGTERM);
+  sigaddset(mask, SIGINT);
+}
+
+/**
+ * @brief check and clear expiration of game timer. Update event loop
+ * @return 1 if tick came since previous call
+ */
+static int timer_expired(EventLoop_t *loop) {
+  int rc = false;
+#ifdef __linux__
+  uint64_t expirations = 0;
+  rc = read(loop->fds[EVENT_SLOT_TIMER].fd, &expirations,
+            sizeof(expirations)) == sizeof(expirations);
+#else
+  int64_t now = monotonic_ms();
+  if (loop->timer_ms >= 0 && now >= loop->deadline) {
+    rc = true;
+    loop->deadline = now + ((loop->timer_ms > 0) ? loop->timer_ms : 1);
+  }
+#endif
+  return rc;
+}
+
+/**
+ * @brief take one signal from signal descriptor
+ * @return EVENT_RESIZE for SIGWINCH, EVENT_TERMINATE for SIGTERM and SIGINT,
+ * EVENT_NONE if nothing was read
+ */
+static EventType_t read_signal(EventLoop_t *loop) {
+  int sig = 0;
+#ifdef __linux__
+  struct signalfd_siginfo si;
+  if (read(loop->fds[EVENT_SLOT_SIGNALS].fd, &si, sizeof(si)) == sizeof(si))
+    sig = (int)si.ssi_signo;
+#else
+  unsigned char c = 0;
+  if (read(loop->fds[EVENT_SLOT_SIGNALS].fd, &c, 1) == 1) sig = c;
+#endif
+  EventType_t type = EVENT_NONE;
+  if (sig == SIGWINCH)
+    type = EVENT_RESIZE;
+  else if (sig)
+    type = EVENT_TERMINATE;
+  return type;
+}
+
+/**
+ * @brief read key without blocking. Update event loop: further keys may be
+ * buffered while keys are read
+ * @return key, INPUT_NONE if there is none
+ *
+ * @note USE_MOCK used for frontend stubs for unit tests of logic
+ */
+static int read_key(EventLoop_t *loop) {
+  int key = INPUT_NONE;
+#ifndef USE_MOCK
+  key = getch();
+  if (key == ERR) key = INPUT_NONE;
+#endif
+  loop->input_pending = (key != INPUT_NONE);
+  return key;
+}
+
+/**
+ * @brief handler of watched descriptor
+ * @param[in] fd descriptor
+ * @return handler, NULL if fd is not watched or has no handler
+ */
+static EventHandler_t handler_of(EventLoop_t *loop, int fd) {
+  EventHandler_t handler = NULL;
+  for (int i = EVENT_SLOT_SIGNALS + 1; i < loop->nfds && !handler; i++)
+    if (loop->fds[i].fd == fd) handler = loop->handlers[i];
+  return handler;
+}
+
+#ifndef __linux__
+/**
+ * @brief handler of loop signals: passes signal number to self-pipe
+ * @param[in] sig signal number
+ */
+static void on_loop_signal(int sig) {
+  int saved = errno;
+  unsigned char c = (unsigned char)sig;
+  ssize_t n = write(updateEventLoop()->signal_pipe, &c, 1);
+  (void)n;
+  errno = saved;
+}
+#endif
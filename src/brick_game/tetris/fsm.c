@@ -13,6 +13,7 @@ static void on_spawn_state(void);
 static void on_moving_state(UserAction_t signal);
 static void on_shifting_state(void);
 static void on_attaching_state(void);
+static void on_paused_state(UserAction_t signal);
 static void on_gameover_state(void);
 static void on_exit_error_state(void);
 
@@ -22,6 +23,7 @@ static void moveright(void);
 static void moveleft(void);
 static void rotate_action(void);
 static void pause_game(void);
+static void resume_game(void);
 
 /**
  * @brief Keeps static object: current game state
@@ -40,13 +42,18 @@ TetrisState_t *updateTetrisState(void) {
  * @details This is the main input handler that routes user actions
  * to the appropriate state-specific handler function. The hold parameter
  * is currently unused but reserved for future input handling improvements.
+ * Calls, time and transition of the handler are counted for perf_dump() and
+ * traced as TRACE_STATE event.
  *
  * @note The hold parameter is cast to void to suppress unused parameter
  * warnings
  */
 void userInput(UserAction_t action, bool hold) {
   TetrisState_t *state = updateTetrisState();
+  TetrisState_t from = *state;
+  int64_t start = (PERF_STATS) ? monotonic_ns() : 0;
   (void)hold;
+  TRACE_BEGIN(TRACE_STATE, from);
   switch (*state) {
     case START:
       on_start_state(action);
@@ -63,6 +70,9 @@ void userInput(UserAction_t action, bool hold) {
     case ATTACHING:
       on_attaching_state();
       break;
+    case PAUSED:
+      on_paused_state(action);
+      break;
     case GAMEOVER:
       on_gameover_state();
       break;
@@ -72,6 +82,8 @@ void userInput(UserAction_t action, bool hold) {
       // default:
       //   break;
   }
+  perf_state_done(from, *state, start);
+  TRACE_END(TRACE_STATE, *state);
 }
 
 /**
@@ -84,6 +96,7 @@ static void on_start_state(UserAction_t signal) {
   TetrisState_t *state = updateTetrisState();
   switch (signal) {
     case Start:
+      updateGameContext()->start_ms = monotonic_ms();
       assign_next_figure();
       *state = SPAWN;
       break;
@@ -108,14 +121,14 @@ static void on_start_state(UserAction_t signal) {
 static void on_spawn_state(void) {
   TetrisState_t *state = updateTetrisState();
 #ifndef USE_MOCK
-  GameInfo_t *game = updateCurrentState();
-  timeout(game->speed);
+  events_set_timer(updateGameState()->speed);
 #endif
   if (high_score_update() == NO_ERROR) {
     copy_next_figure_to_figure();
     assign_next_figure();
     clear_and_print_next_figure();
     init_figure_position();
+    lock_delay_reset();
     print_board();
     print_stats();
     *state = (check_collide()) ? GAMEOVER : MOVING;
@@ -124,10 +137,11 @@ static void on_spawn_state(void) {
 }
 
 /**
- * @brief On MOVING state: awaiting user input for set timeout() period of time
+ * @brief On MOVING state: awaiting user input for game tick period of time
  * @details Awaits user input and calls appropriate function based on it: try to
- * change position or rotate, pause or terminate game. Then game state goes to
- * SHIFTING/PAUSE/GAMEOVER
+ * change position or rotate, pause or terminate game. Moves and rotations are
+ * counted as inputs of the player, every action is sent to versus peer. Then
+ * game state goes to SHIFTING/PAUSED/GAMEOVER
  */
 static void on_moving_state(UserAction_t signal) {
   TetrisState_t *state = updateTetrisState();
@@ -156,61 +170,105 @@ static void on_moving_state(UserAction_t signal) {
     default:
       break;
   }
+  if (signal == Left || signal == Right || signal == Down || signal == Up ||
+      signal == Action)
+    updateGameState()->inputs++;
+  if (signal != No_signal) versus_send_input(signal);
 
-  if (*state != GAMEOVER && *state != EXIT_ERROR) {
+  if (*state != GAMEOVER && *state != EXIT_ERROR && *state != PAUSED) {
     *state = SHIFTING;
   }
 }
 
 /**
- * @brief On SHIFTING state: shifts figure down if it is possible
- * @details If moving figure down causes collision then changes game state to
- * ATTACHING, otherwise change figure position and game state to MOVING. Prints
- * updated board and figure
+ * @brief On SHIFTING state: game tick, lets gravity move figure down
+ * @details If figure has no free rows under it then figure is grounded:
+ * changes game state to ATTACHING once lock delay is over, otherwise back to
+ * MOVING with input timeout cut to the time left. If figure can fall, moves it
+ * down by rows of gravity of this tick, but not deeper than the stack, and
+ * changes game state to MOVING. Prints updated board and figure
+ *
+ * @note USE_MOCK used for frontend stubs for unit tests of logic
  */
 static void on_shifting_state(void) {
   TetrisState_t *state = updateTetrisState();
   FigurePos_t *fig_pos = updateFigurePosition();
-  fig_pos->y++;
-  if (check_collide()) {
-    fig_pos->y--;
-    *state = ATTACHING;
+  int distance = drop_distance();
+  if (distance == 0) {
+    updateGameContext()->gravity_acc = 0;
+    *state = (lock_delay_expired()) ? ATTACHING : MOVING;
+#ifndef USE_MOCK
+    if (*state == MOVING) events_set_timer(lock_delay_remaining());
+#endif
   } else {
+    int rows = gravity_rows();
     *state = MOVING;
-    fig_pos->y--;
-    print_clear_figure(PIXEL_0);
-    fig_pos->y++;
-    print_board();
+    if (rows) {
+      print_clear_figure(PIXEL_0);
+      fig_pos->y += (rows < distance) ? rows : distance;
+      lock_delay_on_fall();
+#ifndef USE_MOCK
+      events_set_timer(updateGameState()->speed);
+#endif
+      print_board();
+    }
   }
 }
 
 /**
  * @brief On ATTACHING state: add figure to field
- * @details If maximum level riched goes to GAMEOVER state
+ * @details Goes to SPAWN state, even if cleared rows held the whole figure. If
+ * figure locked entirely in hidden buffer or maximum level riched and level is
+ * capped (LEVEL_CAP) goes to GAMEOVER state. In versus mode
+ * cleared rows send garbage to the peer, received garbage is inserted before
+ * next figure spawns
  */
 static void on_attaching_state(void) {
-  GameInfo_t *game = updateCurrentState();
+  GameState_t *game = updateGameState();
   TetrisState_t *state = updateTetrisState();
+  int lock_out = check_lock_out();
   attach_figure_to_field();
+  game->pieces++;
   int n_rows = destruction_of_rows();
   recalculate_stats(n_rows);
-  if (*state == ATTACHING && check_collide()) *state = SPAWN;
-  if (game->level > MAX_LEVEL) *state = GAMEOVER;
+  versus_rows_cleared(n_rows);
+  if (*state == ATTACHING) *state = SPAWN;
+  if (lock_out || (LEVEL_CAP && game->level > MAX_LEVEL)) *state = GAMEOVER;
   // *state = (check_collide()) ? GAMEOVER : SPAWN;
   // *state = (game->level > MAX_LEVEL || check_collide()) ? GAMEOVER : SPAWN;
-  if (*state == SPAWN) print_board();
+  if (*state == SPAWN) {
+    versus_figure_locked();
+    print_board();
+  }
+}
+
+/**
+ * @brief On PAUSED state: awaiting user input, game timer is stopped
+ * @details Game loop keeps running while paused, only pause and terminate
+ * inputs are handled: resume game (state goes to MOVING) or go to GAMEOVER
+ */
+static void on_paused_state(UserAction_t signal) {
+  TetrisState_t *state = updateTetrisState();
+  if (signal == Pause)
+    resume_game();
+  else if (signal == Terminate)
+    *state = GAMEOVER;
 }
 
 /**
- * @brief On GAMEOVER state: prints banner, awaits for input to quit
+ * @brief On GAMEOVER state: tells versus peer, records the game in the
+ * leaderboard and the session log, prints banner, awaits for input to quit
  *
  * @note USE_MOCK used for frontend stubs for unit tests of logic
  */
 static void on_gameover_state(void) {
+  versus_game_over();
+  leaderboard_record();
+  session_log_record();
 #ifndef USE_MOCK
-  nodelay(stdscr, false);
   print_gameover_banner();
-  getch();
+  print_frame();
+  events_wait_key();
 #endif
 }
 
@@ -221,16 +279,16 @@ static void on_gameover_state(void) {
  */
 static void on_exit_error_state(void) {
 #ifndef USE_MOCK
-  nodelay(stdscr, false);
   print_exit_error_banner();
-  getch();
+  print_frame();
+  events_wait_key();
 #endif
 }
 
 /**
  * @brief Processes user input and treturns action to be done based on it
  * @param[in] signal signal received from stdin (int)
- * @details Initial signal = 0. Then in the loop it is awaiting for timeout()
+ * @details Initial signal = 0. Then in the loop it is awaiting for game tick
  * period of time for new input or proceed game state status accordingly
  */
 UserAction_t get_action(int signal) {
@@ -263,64 +321,94 @@ static void __attribute__((unused)) moveup(void) {}
 
 /**
  * @brief Moves the figure all the way down till it reaches field or border.
+ * Hard dropped figure locks without lock delay.
  * Updates figure output (prints 0 on initial position and 1 on new position)
  */
 static void movedown(void) {
   FigurePos_t *fig_pos = updateFigurePosition();
   print_clear_figure(PIXEL_0);
-  while (!check_collide()) fig_pos->y++;
-  fig_pos->y--;
+  fig_pos->y += drop_distance();
+  lock_delay_force();
   print_clear_figure(PIXEL_1);
 }
 
 /**
  * @brief Moves the figure to the right if it will not cause collision.
+ * Successful move restarts lock delay of grounded figure.
  * Updates figure output (prints 0 on initial position and 1 on new position)
  */
 static void moveright(void) {
   FigurePos_t *fig_pos = updateFigurePosition();
   print_clear_figure(PIXEL_0);
   fig_pos->x++;
-  if (check_collide()) fig_pos->x--;
+  if (check_collide())
+    fig_pos->x--;
+  else
+    lock_delay_on_move();
   print_clear_figure(PIXEL_1);
 }
 
 /**
  * @brief Moves the figure to the left if it will not cause collision.
+ * Successful move restarts lock delay of grounded figure.
  * Updates figure output (prints 0 on initial position and 1 on new position)
  */
 static void moveleft(void) {
   FigurePos_t *fig_pos = updateFigurePosition();
   print_clear_figure(PIXEL_0);
   fig_pos->x--;
-  if (check_collide()) fig_pos->x++;
+  if (check_collide())
+    fig_pos->x++;
+  else
+    lock_delay_on_move();
   print_clear_figure(PIXEL_1);
 }
 
 /**
- * @brief Rotates the figure if it will not cause collision.
+ * @brief Rotates the figure, kicking it off walls and stack if rotation in
+ * place collides. Successful rotation restarts lock delay of grounded figure.
  * Updates figure output (prints 0 on initial position and 1 on new position)
  */
 static void rotate_action(void) {
-  int **figure = updateFigure();
   print_clear_figure(PIXEL_0);
-  rotate_figure(figure);
-  if (check_collide())
-    for (int r = 0; r < 3; r++) rotate_figure(figure);
+  if (rotate_figure_with_kicks()) lock_delay_on_move();
   print_clear_figure(PIXEL_1);
 }
 
 /**
- * @brief Pauses the game, awaits for input to quit
+ * @brief Pauses the game: prints banner, stops game timer, game state goes to
+ * PAUSED. Game loop keeps waiting for events instead of blocking in input
  *
  * @note USE_MOCK used for frontend stubs for unit tests of logic
  */
 static void pause_game(void) {
-#ifndef USE_MOCK
-  GameInfo_t *game = updateCurrentState();
-  nodelay(stdscr, false);
+  GameState_t *game = updateGameState();
+  game->pause = true;
+  game->context.pause_start = monotonic_ms();
+  *updateTetrisState() = PAUSED;
   print_pause_banner();
-  getch();
-  timeout(game->speed);
+#ifndef USE_MOCK
+  events_set_timer(-1);
+#endif
+}
+
+/**
+ * @brief Resumes the game: lock delay of grounded figure and start time of
+ * the game are moved by the time spent in pause, board is printed over the
+ * banner, game state goes to MOVING
+ *
+ * @note USE_MOCK used for frontend stubs for unit tests of logic
+ */
+static void resume_game(void) {
+  GameState_t *game = updateGameState();
+  GameContext_t *context = &game->context;
+  game->pause = false;
+  if (context->lock_active)
+    context->lock_start += monotonic_ms() - context->pause_start;
+  context->start_ms += monotonic_ms() - context->pause_start;
+  *updateTetrisState() = MOVING;
+  print_board();
+#ifndef USE_MOCK
+  events_set_timer(game->speed);
 #endif
 }
@@ -0,0 +1,237 @@
+/**
+ * @file leaderboard.c
+ * @brief Leaderboard of top scores in a memory-mapped binary file
+ * @details This file implements mapping and atomic creation of the leaderboard
+ * file, binary search of ranks and double-buffered updates under advisory
+ * lock with static object of leaderboard state.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../include/tetris.h"
+
+static int create_file(char const *path);
+static int valid_file(LeaderboardFile_t const *file);
+static int write_entry(LeaderboardFile_t *file, LeaderboardEntry_t const *entry,
+                       int rank);
+static int lock_file(int fd, short type);
+
+/**
+ * @brief Keeps static object: leaderboard state
+ *
+ * @return Pointer to leaderboard state
+ */
+Leaderboard_t *updateLeaderboard(void) {
+  static Leaderboard_t lb = {.fd = -1, .path = LEADERBOARD_FILE};
+  return &lb;
+}
+
+/**
+ * @brief map leaderboard file, missing file is created empty. Update
+ * leaderboard state
+ * @param[in] path file path
+ * @return error code
+ */
+int leaderboard_open(char const *path) {
+  Leaderboard_t *lb = updateLeaderboard();
+  struct stat sb;
+  int error = ERROR;
+  leaderboard_close();
+  lb->fd = open(path, O_RDWR);
+  if (lb->fd < 0 && errno == ENOENT && create_file(path) == NO_ERROR)
+    lb->fd = open(path, O_RDWR);
+  if (lb->fd >= 0 && fstat(lb->fd, &sb) == 0 &&
+      sb.st_size == sizeof(LeaderboardFile_t)) {
+    void *map = mmap(NULL, sizeof(LeaderboardFile_t), PROT_READ | PROT_WRITE,
+                     MAP_SHARED, lb->fd, 0);
+    if (map != MAP_FAILED) {
+      lb->file = map;
+      if (valid_file(lb->file)) error = NO_ERROR;
+    }
+  }
+  if (error) leaderboard_close();
+  return error;
+}
+
+/**
+ * @brief unmap and close leaderboard file, path is kept. Update leaderboard
+ * state
+ */
+void leaderboard_close(void) {
+  Leaderboard_t *lb = updateLeaderboard();
+  if (lb->file) munmap(lb->file, sizeof(LeaderboardFile_t));
+  if (lb->fd >= 0) close(lb->fd);
+  *lb = (Leaderboard_t){.fd = -1, .path = lb->path};
+}
+
+/**
+ * @brief current table of mapped file
+ * @return games, NULL if leaderboard is not open
+ */
+LeaderboardTable_t const *leaderboard_table(void) {
+  LeaderboardFile_t const *file = updateLeaderboard()->file;
+  return (file) ? &file->tables[file->generation % 2] : NULL;
+}
+
+/**
+ * @brief binary search of the first game with lower score
+ * @param[in] score score
+ * @return rank: number of games with the same or higher score
+ */
+int leaderboard_rank(int score) {
+  LeaderboardTable_t const *table = leaderboard_table();
+  int lo = 0;
+  int hi = (table) ? (int)table->count : 0;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (table->entries[mid].score >= score)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/**
+ * @brief best score of the leaderboard
+ * @return score, 0 if there is no game
+ */
+int leaderboard_top_score(void) {
+  LeaderboardTable_t const *table = leaderboard_table();
+  return (table && table->count > 0) ? table->entries[0].score : 0;
+}
+
+/**
+ * @brief insert game under exclusive lock of the file: rank is found and the
+ * table is written with other instances waiting, so none of them loses its
+ * update. Readers of the current table need no lock, writers only touch the
+ * inactive one. Update leaderboard file
+ * @param[in] entry game
+ * @return rank of the game, -1 if it is not recorded
+ */
+int leaderboard_insert(LeaderboardEntry_t const *entry) {
+  Leaderboard_t *lb = updateLeaderboard();
+  int rank = -1;
+  if (lb->file && entry->score > 0 && lock_file(lb->fd, F_WRLCK) == 0) {
+    rank = leaderboard_rank(entry->score);
+    rank = (rank < LEADERBOARD_SIZE) ? write_entry(lb->file, entry, rank) : -1;
+    lock_file(lb->fd, F_UNLCK);
+  }
+  return rank;
+}
+
+/**
+ * @brief insert finished current game: score, level, rows cleared, time
+ * played and start seed under USER name
+ * @return rank of the game, -1 if it is not recorded
+ */
+int leaderboard_record(void) {
+  GameState_t *game = updateGameState();
+  LeaderboardEntry_t entry = {.score = game->score,
+                              .level = game->level,
+                              .lines = game->lines,
+                              .duration_s = play_time_ms() / 1000,
+                              .seed = game->start_seed};
+  char const *name = getenv("USER");
+  int rank = -1;
+  snprintf(entry.name, sizeof(entry.name), "%s",
+           (name && *name) ? name : LEADERBOARD_DEFAULT_NAME);
+  TRACE_BEGIN(TRACE_HIGH_SCORE_IO, game->score);
+  if (updateLeaderboard()->file ||
+      leaderboard_open(updateLeaderboard()->path) == NO_ERROR)
+    rank = leaderboard_insert(&entry);
+  TRACE_END(TRACE_HIGH_SCORE_IO, rank);
+  return rank;
+}
+
+/**
+ * @brief write current table with the game inserted at its rank into the
+ * inactive table, sync it, then switch generation and sync the header
+ * @param[in] file mapped file
+ * @param[in] entry game
+ * @param[in] rank rank of the game
+ * @return rank of the game, -1 if the file cannot be synced
+ */
+static int write_entry(LeaderboardFile_t *file, LeaderboardEntry_t const *entry,
+                       int rank) {
+  LeaderboardTable_t const *cur = &file->tables[file->generation % 2];
+  LeaderboardTable_t *next = &file->tables[(file->generation + 1) % 2];
+  int count = ((int)cur->count < LEADERBOARD_SIZE) ? (int)cur->count + 1
+                                                   : LEADERBOARD_SIZE;
+  memcpy(next->entries, cur->entries, rank * sizeof(*entry));
+  next->entries[rank] = *entry;
+  memcpy(next->entries + rank + 1, cur->entries + rank,
+         (count - rank - 1) * sizeof(*entry));
+  next->count = count;
+  if (msync(file, sizeof(*file), MS_SYNC) == 0) {
+    file->generation++;
+    if (msync(file, sizeof(*file), MS_SYNC) != 0) rank = -1;
+  } else {
+    rank = -1;
+  }
+  return rank;
+}
+
+/**
+ * @brief take or release advisory lock of the whole file, waits for other
+ * instances holding it
+ * @param[in] fd file
+ * @param[in] type F_WRLCK or F_UNLCK
+ * @return 0 on success, -1 on error
+ */
+static int lock_file(int fd, short type) {
+  struct flock lock = {.l_type = type, .l_whence = SEEK_SET};
+  int rc = fcntl(fd, F_SETLKW, &lock);
+  while (rc != 0 && errno == EINTR) rc = fcntl(fd, F_SETLKW, &lock);
+  return rc;
+}
+
+/**
+ * @brief write empty leaderboard to temporary file next to path and link it
+ * into place, so path never has a partial file. Path created meanwhile by
+ * another instance is kept: replacing it would lose its games
+ * @param[in] path file path
+ * @return error code
+ */
+static int create_file(char const *path) {
+  static LeaderboardFile_t empty;
+  char tmp[256];
+  int error = ERROR;
+  empty = (LeaderboardFile_t){.magic = LEADERBOARD_MAGIC,
+                              .version = LEADERBOARD_VERSION,
+                              .capacity = LEADERBOARD_SIZE};
+  if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) < (int)sizeof(tmp)) {
+    int fd = mkstemp(tmp);
+    if (fd >= 0) {
+      if (fchmod(fd, 0644) == 0 &&
+          write(fd, &empty, sizeof(empty)) == sizeof(empty) &&
+          fsync(fd) == 0 && (link(tmp, path) == 0 || errno == EEXIST))
+        error = NO_ERROR;
+      close(fd);
+      unlink(tmp);
+    }
+  }
+  return error;
+}
+
+/**
+ * @brief check header of mapped file
+ * @param[in] file mapped file
+ * @return 1 if it is a leaderboard of this format and size
+ */
+static int valid_file(LeaderboardFile_t const *file) {
+  return file->magic == LEADERBOARD_MAGIC &&
+         file->version == LEADERBOARD_VERSION &&
+         file->capacity == LEADERBOARD_SIZE &&
+         file->tables[0].count <= LEADERBOARD_SIZE &&
+         file->tables[1].count <= LEADERBOARD_SIZE;
+}
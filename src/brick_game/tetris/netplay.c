@@ -0,0 +1,325 @@
+/**
+ * @file netplay.c
+ * @brief Lockstep deterministic netplay with input delay and rollback
+ * @details This file implements fixed frame simulation of both games from
+ * inputs, snapshots and rollback on mispredicted peer input and the netplay
+ * game loop with static object of netplay state.
+ */
+
+#include <string.h>
+
+#include "../../include/tetris.h"
+
+static void simulate(Netplay_t *np);
+static void rollback(Netplay_t *np);
+static void step_game(NetplaySim_t *sim, int p, UserAction_t action);
+static void move_figure(UserAction_t action);
+static void lock_figure(NetplaySim_t *sim, int p);
+static int spawn_figure(void);
+#ifndef USE_MOCK
+static void show_frame(Netplay_t const *np);
+#endif
+
+/**
+ * @brief Keeps static object: netplay state
+ *
+ * @return Pointer to netplay state
+ */
+Netplay_t *updateNetplay(void) {
+  static Netplay_t np = {.rollback_to = -1};
+  return &np;
+}
+
+/**
+ * @brief start both games from the same seed, first NETPLAY_INPUT_DELAY
+ * frames have no input on both sides. Update netplay state, local game goes
+ * to game state
+ * @param[in] np netplay state
+ * @param[in] seed seed of both games
+ * @param[in] local index of local player
+ */
+void netplay_start(Netplay_t *np, uint32_t seed, int local) {
+  int enabled = np->enabled;
+  memset(np, 0, sizeof(*np));
+  np->enabled = enabled;
+  np->started = true;
+  np->local = local;
+  np->rollback_to = -1;
+  np->confirmed = NETPLAY_INPUT_DELAY - 1;
+  for (int f = 0; f < NETPLAY_HISTORY; f++) {
+    np->remote_frames[f] = (f < NETPLAY_INPUT_DELAY) ? f : -1;
+    np->remote_inputs[f] = No_signal;
+    np->local_inputs[f] = No_signal;
+  }
+  for (int p = 0; p < 2; p++) {
+    reset_game_state(seed);
+    assign_next_figure();
+    spawn_figure();
+    np->sim.games[p] = *updateGameState();
+  }
+  *updateGameState() = np->sim.games[local];
+}
+
+/**
+ * @brief simulate next frame: roll back first if peer input was
+ * mispredicted, schedule local action NETPLAY_INPUT_DELAY frames ahead. Does
+ * nothing while more than NETPLAY_MAX_ROLLBACK frames would be predicted.
+ * Update netplay state, local game goes to game state
+ * @param[in] np netplay state
+ * @param[in] action local action
+ * @param[out] msg input message for the peer
+ * @return 1 if frame was simulated, 0 if waiting for peer
+ */
+int netplay_tick(Netplay_t *np, UserAction_t action, VersusMsg_t *msg) {
+  int advanced = false;
+  if (np->started && np->frame - np->confirmed <= NETPLAY_MAX_ROLLBACK) {
+    int input_frame = np->frame + NETPLAY_INPUT_DELAY;
+    if (np->rollback_to >= 0) rollback(np);
+    np->local_inputs[input_frame % NETPLAY_HISTORY] = (uint8_t)action;
+    *msg = (VersusMsg_t){VERSUS_MSG_LOCKSTEP, (uint8_t)action,
+                         (uint16_t)input_frame, 0};
+    simulate(np);
+    *updateGameState() = np->sim.games[np->local];
+    advanced = true;
+  } else if (np->started) {
+    np->stalls++;
+  }
+  return advanced;
+}
+
+/**
+ * @brief take peer input: full frame number is restored from its low 16 bits
+ * near the first unconfirmed frame. Input that differs from the one simulated
+ * marks rollback to its frame. Update netplay state
+ * @param[in] np netplay state
+ * @param[in] msg VERSUS_MSG_LOCKSTEP message
+ */
+void netplay_remote_input(Netplay_t *np, VersusMsg_t msg) {
+  int base = np->confirmed + 1;
+  int f = base + (int16_t)(uint16_t)(msg.value - (uint16_t)base);
+  int slot = f % NETPLAY_HISTORY;
+  if (np->started && f >= base && f < base + NETPLAY_HISTORY) {
+    np->remote_inputs[slot] = msg.arg;
+    np->remote_frames[slot] = f;
+    if (f < np->frame && np->used_inputs[slot] != msg.arg &&
+        (np->rollback_to < 0 || f < np->rollback_to))
+      np->rollback_to = f;
+    while (np->remote_frames[(np->confirmed + 1) % NETPLAY_HISTORY] ==
+           np->confirmed + 1)
+      np->confirmed++;
+  }
+}
+
+/**
+ * @brief result of the match when every simulated frame used received peer
+ * input
+ * @param[in] np netplay state
+ * @return -1 - match goes on, 0 - local player lost, 1 - local player won
+ */
+int netplay_result(Netplay_t const *np) {
+  int rc = -1;
+  if (np->started && np->frame - 1 <= np->confirmed) {
+    if (np->sim.over[np->local])
+      rc = 0;
+    else if (np->sim.over[1 - np->local])
+      rc = 1;
+  }
+  return rc;
+}
+
+/**
+ * @brief keep snapshot of frame, simulate it with local input and received or
+ * predicted (no input) peer input. Update netplay state
+ */
+static void simulate(Netplay_t *np) {
+  int slot = np->frame % NETPLAY_HISTORY;
+  uint8_t inputs[2];
+  np->snapshots[slot] = np->sim;
+  np->used_inputs[slot] = (np->remote_frames[slot] == np->frame)
+                              ? np->remote_inputs[slot]
+                              : No_signal;
+  inputs[np->local] = np->local_inputs[slot];
+  inputs[1 - np->local] = np->used_inputs[slot];
+  set_game_clock((int64_t)np->frame * NETPLAY_FRAME_MS);
+  for (int p = 0; p < 2; p++)
+    if (!np->sim.over[p]) step_game(&np->sim, p, inputs[p]);
+  set_game_clock(-1);
+  np->frame++;
+}
+
+/**
+ * @brief restore games from snapshot of mispredicted frame and simulate them
+ * again up to current frame. Update netplay state
+ */
+static void rollback(Netplay_t *np) {
+  int64_t start = monotonic_ns();
+  int frame = np->frame;
+  np->sim = np->snapshots[np->rollback_to % NETPLAY_HISTORY];
+  np->frame = np->rollback_to;
+  while (np->frame < frame) {
+    simulate(np);
+    np->resimulated++;
+  }
+  np->rollbacks++;
+  np->rollback_to = -1;
+  if (monotonic_ns() - start > np->rollback_ns)
+    np->rollback_ns = monotonic_ns() - start;
+}
+
+/**
+ * @brief simulate one frame of game of player: action, game tick every speed
+ * ms of simulated time, lock of grounded figure after lock delay
+ * @param[in] sim simulated games
+ * @param[in] p player
+ * @param[in] action action of player
+ */
+static void step_game(NetplaySim_t *sim, int p, UserAction_t action) {
+  GameState_t *st = updateGameState();
+  GameContext_t *context = &st->context;
+  *st = sim->games[p];
+  move_figure(action);
+  context->tick_ms += NETPLAY_FRAME_MS;
+  if (context->tick_ms >= st->speed) {
+    int distance = drop_distance();
+    int rows = (distance) ? gravity_rows() : 0;
+    context->tick_ms -= st->speed;
+    if (distance == 0) context->gravity_acc = 0;
+    if (rows) {
+      st->figure_pos.y += (rows < distance) ? rows : distance;
+      lock_delay_on_fall();
+    }
+  }
+  if (drop_distance() == 0 && lock_delay_expired()) lock_figure(sim, p);
+  sim->games[p] = *st;
+}
+
+/**
+ * @brief apply action to current figure as MOVING state does: move, rotate
+ * or hard drop
+ * @param[in] action action
+ */
+static void move_figure(UserAction_t action) {
+  FigurePos_t *fig_pos = updateFigurePosition();
+  int dx = (action == Left) ? -1 : (action == Right) ? 1 : 0;
+  if (dx) {
+    fig_pos->x += dx;
+    if (check_collide())
+      fig_pos->x -= dx;
+    else
+      lock_delay_on_move();
+  } else if (action == Action) {
+    if (rotate_figure_with_kicks()) lock_delay_on_move();
+  } else if (action == Down) {
+    fig_pos->y += drop_distance();
+    lock_delay_force();
+  }
+}
+
+/**
+ * @brief lock figure as ATTACHING state does, exchange garbage with the other
+ * player, insert pending garbage and spawn next figure
+ * @param[in] sim simulated games
+ * @param[in] p player
+ */
+static void lock_figure(NetplaySim_t *sim, int p) {
+  int lock_out = check_lock_out();
+  attach_figure_to_field();
+  updateGameState()->pieces++;
+  int n_rows = destruction_of_rows();
+  recalculate_stats(n_rows);
+  int rows = versus_garbage_for(n_rows);
+  int cancel = (rows < sim->pending[p]) ? rows : sim->pending[p];
+  sim->pending[p] -= cancel;
+  sim->pending[1 - p] += rows - cancel;
+  if (sim->pending[1 - p] > ROWS_MAP) sim->pending[1 - p] = ROWS_MAP;
+  insert_garbage_rows(sim->pending[p]);
+  sim->pending[p] = 0;
+  if (spawn_figure() || lock_out) sim->over[p] = true;
+}
+
+/**
+ * @brief next figure becomes current one at spawn position
+ * @return 1 if spawned figure collides
+ */
+static int spawn_figure(void) {
+  copy_next_figure_to_figure();
+  assign_next_figure();
+  init_figure_position();
+  lock_delay_reset();
+  return check_collide();
+}
+
+/**
+ * @brief Game loop of netplay: sleeps in the event loop, queues local
+ * actions, simulates a frame on every timer tick once the peer is connected
+ * and shows the local game. Ends when the match result is final, the peer
+ * quits or leaves or the player quits: then the peer is told the game is over
+ *
+ * @note USE_MOCK used for frontend stubs for unit tests of logic
+ */
+void netplay_loop(void) {
+#ifndef USE_MOCK
+  Netplay_t *np = updateNetplay();
+  Versus_t *vs = updateVersus();
+  UserAction_t queue[NETPLAY_QUEUE];
+  int queued = 0;
+  int running = true;
+  int ticking = false;
+  int signal = INPUT_NONE;
+  while (running) {
+    if (np->started && !ticking) {
+      ticking = true;
+      events_set_timer(NETPLAY_FRAME_MS);
+      show_frame(np);
+    }
+    print_frame();
+    signal = events_read_input(true);
+    UserAction_t action = get_action(signal);
+    VersusMsg_t msg;
+    if (signal == INPUT_TERMINATE || action == Terminate) {
+      running = false;
+    } else if (signal == INPUT_RESIZE) {
+      resize_panels();
+      if (ticking)
+        print_game_screen();
+      else
+        print_overlay();
+    } else if (signal == INPUT_TICK && ticking) {
+      if (netplay_tick(np, (queued) ? queue[0] : No_signal, &msg)) {
+        versus_send(msg);
+        if (queued) memmove(queue, queue + 1, --queued * sizeof(queue[0]));
+        show_frame(np);
+      }
+    } else if (signal >= 0 && action != No_signal && queued < NETPLAY_QUEUE) {
+      queue[queued++] = action;
+    }
+    if (ticking && (netplay_result(np) >= 0 || vs->fd < 0)) running = false;
+  }
+  int result = netplay_result(np);
+  events_set_timer(-1);
+  if (result < 0 && !vs->peer_over) versus_game_over();
+  if (result >= 0)
+    vs->peer_over = result;
+  else if (ticking && vs->fd < 0)
+    vs->peer_over = true;
+  *updateTetrisState() = GAMEOVER;
+  print_gameover_banner();
+  print_frame();
+  if (signal != INPUT_TERMINATE) events_wait_key();
+#endif
+}
+
+#ifndef USE_MOCK
+/**
+ * @brief draw local game, pending garbage and stack height of the peer
+ */
+static void show_frame(Netplay_t const *np) {
+  Versus_t *vs = updateVersus();
+  vs->pending_garbage = np->sim.pending[np->local];
+  vs->peer_height = versus_stack_height(&np->sim.games[1 - np->local]);
+  updateCurrentState();
+  print_board();
+  print_stats();
+  clear_and_print_next_figure();
+}
+#endif
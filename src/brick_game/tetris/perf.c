@@ -0,0 +1,270 @@
+/**
+ * @file perf.c
+ * @brief Frame time, input latency and engine counters instrumentation
+ * @details This file implements rolling histograms and timestamps of game loop
+ * cycles, state and engine function counters and their JSON dump with static
+ * object of instrumentation state.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../include/tetris.h"
+
+/**
+ * @brief Names of states in counters dump, indexed by TetrisState_t
+ */
+static char const *const state_names[NUMBER_OF_STATES] = {
+    "START",     "SPAWN",  "MOVING",   "SHIFTING",
+    "ATTACHING", "PAUSED", "GAMEOVER", "EXIT_ERROR"};
+
+/**
+ * @brief Names of engine functions in counters dump, indexed by PerfFunc_t
+ */
+static char const *const func_names[PERF_FUNCS] = {
+    "assign_next_figure",       "copy_next_figure_to_figure",
+    "high_score_update",        "init_figure_position",
+    "check_collide",            "drop_distance",
+    "gravity_rows",             "rotate_figure_with_kicks",
+    "check_lock_out",           "attach_figure_to_field",
+    "destruction_of_rows",      "recalculate_stats"};
+
+/**
+ * @brief Set by SIGUSR1 handler, counters dump is requested
+ */
+static volatile sig_atomic_t dump_requested = 0;
+
+static int bucket_of(int64_t us);
+static int64_t bucket_upper(int bucket);
+static void on_dump_signal(int sig);
+
+/**
+ * @brief Keeps static object: instrumentation state
+ *
+ * @return Pointer to instrumentation state
+ */
+PerfStats_t *updatePerfStats(void) {
+  static PerfStats_t perf = {0};
+  return &perf;
+}
+
+/**
+ * @brief add sample to rolling histogram, the oldest sample is evicted when
+ * the window is full
+ * @param[in] hist histogram
+ * @param[in] us sample, microseconds
+ */
+void perf_histogram_add(PerfHistogram_t *hist, int64_t us) {
+  int bucket = bucket_of(us);
+  if (hist->n == PERF_WINDOW)
+    hist->count[hist->ring[hist->head]]--;
+  else
+    hist->n++;
+  hist->ring[hist->head] = (uint8_t)bucket;
+  hist->count[bucket]++;
+  hist->head = (hist->head + 1) % PERF_WINDOW;
+}
+
+/**
+ * @brief percentile of rolling histogram
+ * @param[in] hist histogram
+ * @param[in] percent percentile, 1..100
+ * @return upper bound of bucket of the percentile, microseconds, 0 if
+ * histogram is empty
+ */
+int64_t perf_percentile(PerfHistogram_t const *hist, int percent) {
+  int64_t rc = 0;
+  int rank = (hist->n * percent + 99) / 100;
+  for (int b = 0, seen = 0; b < PERF_BUCKETS && hist->n > 0; b++) {
+    seen += hist->count[b];
+    if (seen >= rank) {
+      rc = bucket_upper(b);
+      break;
+    }
+  }
+  return rc;
+}
+
+/**
+ * @brief mark input arrival: getch returned, new loop cycle starts. Update
+ * instrumentation state
+ * @param[in] has_input 1 if getch returned a key, 0 on timeout
+ */
+void perf_cycle_start(int has_input) {
+  if (PERF_STATS) {
+    PerfStats_t *perf = updatePerfStats();
+    perf->cycle_start = monotonic_ns();
+    perf->has_input = has_input;
+  }
+}
+
+/**
+ * @brief mark state transition, state machine is done with the input of the
+ * cycle. Update input latency histogram
+ */
+void perf_transition(void) {
+  PerfStats_t *perf = updatePerfStats();
+  if (PERF_STATS && perf->cycle_start) {
+    perf->transition = monotonic_ns();
+    if (perf->has_input)
+      perf_histogram_add(&perf->input,
+                         (perf->transition - perf->cycle_start) / 1000);
+  }
+}
+
+/**
+ * @brief mark render completion, frame of the cycle is sent. Update frame
+ * time histogram
+ */
+void perf_render_done(void) {
+  PerfStats_t *perf = updatePerfStats();
+  if (PERF_STATS && perf->cycle_start)
+    perf_histogram_add(&perf->frame,
+                       (monotonic_ns() - perf->cycle_start) / 1000);
+}
+
+/**
+ * @brief show or hide debug panel. Update instrumentation state
+ */
+void perf_toggle(void) {
+  PerfStats_t *perf = updatePerfStats();
+  if (PERF_STATS) perf->visible = !perf->visible;
+}
+
+/**
+ * @brief bucket of sample: values below 8 have own buckets, then every power
+ * of two is split in 8 linear buckets
+ * @param[in] us sample, microseconds
+ * @return bucket index
+ */
+static int bucket_of(int64_t us) {
+  int rc = 0;
+  if (us >= 8) {
+    uint64_t v = (us < ((int64_t)1 << 32)) ? (uint64_t)us : UINT32_MAX;
+    int e = 63 - __builtin_clzll(v);
+    rc = (e - 2) * 8 + (int)((v >> (e - 3)) & 7);
+  } else if (us > 0) {
+    rc = (int)us;
+  }
+  return rc;
+}
+
+/**
+ * @brief largest sample of bucket
+ * @param[in] bucket bucket index
+ * @return upper bound, microseconds
+ */
+static int64_t bucket_upper(int bucket) {
+  int64_t rc = bucket;
+  if (bucket >= 8) {
+    int e = bucket / 8 + 2;
+    rc = ((int64_t)(8 + bucket % 8 + 1) << (e - 3)) - 1;
+  }
+  return rc;
+}
+
+/**
+ * @brief count call of engine function. Update instrumentation state
+ * @param[in] func function
+ */
+void perf_count(PerfFunc_t func) {
+  if (PERF_STATS) updatePerfStats()->func_calls[func]++;
+}
+
+/**
+ * @brief record call of state handler: its time and transition. Update
+ * instrumentation state
+ * @param[in] from state the handler was called in
+ * @param[in] to state after the handler
+ * @param[in] start time the handler was called, monotonic_ns()
+ */
+void perf_state_done(TetrisState_t from, TetrisState_t to, int64_t start) {
+  if (PERF_STATS) {
+    PerfStats_t *perf = updatePerfStats();
+    perf->state_calls[from]++;
+    perf->state_ns[from] += monotonic_ns() - start;
+    perf->transitions[from][to]++;
+  }
+}
+
+/**
+ * @brief write counters as JSON: calls and nanoseconds per state, non-zero
+ * transitions per state and calls per engine function
+ * @param[in] path file path
+ * @return error code
+ */
+int perf_dump(char const *path) {
+  PerfStats_t *perf = updatePerfStats();
+  int error = NO_ERROR;
+  FILE *out = fopen(path, "w");
+  if (out) {
+    fprintf(out, "{\n  \"states\": {");
+    for (int i = 0; i < NUMBER_OF_STATES; i++)
+      fprintf(out, "%s\n    \"%s\": {\"calls\": %llu, \"ns\": %lld}",
+              (i) ? "," : "", state_names[i],
+              (unsigned long long)perf->state_calls[i],
+              (long long)perf->state_ns[i]);
+    fprintf(out, "\n  },\n  \"transitions\": {");
+    for (int i = 0; i < NUMBER_OF_STATES; i++) {
+      fprintf(out, "%s\n    \"%s\": {", (i) ? "," : "", state_names[i]);
+      for (int j = 0, n = 0; j < NUMBER_OF_STATES; j++)
+        if (perf->transitions[i][j])
+          fprintf(out, "%s\"%s\": %llu", (n++) ? ", " : "", state_names[j],
+                  (unsigned long long)perf->transitions[i][j]);
+      fprintf(out, "}");
+    }
+    fprintf(out, "\n  },\n  \"functions\": {");
+    for (int i = 0; i < PERF_FUNCS; i++)
+      fprintf(out, "%s\n    \"%s\": %llu", (i) ? "," : "", func_names[i],
+              (unsigned long long)perf->func_calls[i]);
+    fprintf(out, "\n  }\n}\n");
+    if (fclose(out) != 0) error = ERROR;
+  } else {
+    error = ERROR;
+  }
+  return error;
+}
+
+/**
+ * @brief path of counters dump: environment variable PERF_DUMP_ENV if it is
+ * set, PERF_DUMP_FILE otherwise
+ * @return file path
+ */
+char const *perf_dump_path(void) {
+  char const *path = getenv(PERF_DUMP_ENV);
+  return (path && *path) ? path : PERF_DUMP_FILE;
+}
+
+/**
+ * @brief install SIGUSR1 handler requesting counters dump
+ * @return error code
+ */
+int perf_install_dump_signal(void) {
+  struct sigaction sa = {0};
+  sa.sa_handler = on_dump_signal;
+  sigemptyset(&sa.sa_mask);
+  return (sigaction(SIGUSR1, &sa, NULL) == 0) ? NO_ERROR : ERROR;
+}
+
+/**
+ * @brief write counters dump if SIGUSR1 was received since previous call
+ */
+void perf_poll_dump(void) {
+  if (dump_requested) {
+    dump_requested = 0;
+    perf_dump(perf_dump_path());
+  }
+}
+
+/**
+ * @brief SIGUSR1 handler: only sets the flag, dump is written by game loop
+ * @param[in] sig signal number (unused)
+ */
+static void on_dump_signal(int sig) {
+  (void)sig;
+  dump_requested = 1;
+}
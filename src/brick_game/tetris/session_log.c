@@ -0,0 +1,357 @@
+/**
+ * @file session_log.c
+ * @brief Append-only log of finished games and its per-day compaction
+ * @details This file implements locked single-write appends to the session
+ * log, its aggregation into per-day summaries written atomically with the
+ * compacted log offset and printing of the summaries.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../include/tetris.h"
+
+static int open_log(char const *path, int flags, short type);
+static int replace_log(char const *path);
+static int read_days(char const *path, SessionDaysHeader_t *header,
+                     SessionDay_t **days, int *n_days);
+static int add_record(SessionDay_t **days, int *n_days, int *capacity,
+                      SessionRecord_t const *record);
+static int write_days(char const *path, SessionDaysHeader_t const *header,
+                      SessionDay_t const *days, int n_days);
+static int lock_file(int fd, short type);
+
+/**
+ * @brief Keeps static object: files of the session log
+ *
+ * @return Pointer to files of the session log
+ */
+SessionLog_t *updateSessionLog(void) {
+  static SessionLog_t log = {.log_path = SESSION_LOG_FILE,
+                             .days_path = SESSION_DAYS_FILE};
+  return &log;
+}
+
+/**
+ * @brief append record with one O_APPEND write under shared lock of the log,
+ * so it never lands in the middle of compaction
+ * @param[in] path file path of the session log
+ * @param[in] record record
+ * @return number of records in the log, -1 on error
+ */
+int session_log_append(char const *path, SessionRecord_t const *record) {
+  struct stat sb;
+  int n = -1;
+  int fd = open_log(path, O_RDWR | O_APPEND | O_CREAT, F_RDLCK);
+  if (fd >= 0) {
+    if (write(fd, record, sizeof(*record)) == sizeof(*record) &&
+        fstat(fd, &sb) == 0)
+      n = sb.st_size / sizeof(*record);
+    close(fd);
+  }
+  return n;
+}
+
+/**
+ * @brief add records of the log past the offset compacted before to per-day
+ * summaries under exclusive lock of the log, write summaries with the log
+ * inode and new offset to temporary file renamed into place, then replace the
+ * log with an empty one. Crash between the two leaves the offset to skip
+ * already added records. Partial record at the end of the log is dropped
+ * @param[in] log_path file path of the session log
+ * @param[in] days_path file path of per-day summaries
+ * @return number of days, -1 on error
+ */
+int session_log_compact(char const *log_path, char const *days_path) {
+  static SessionRecord_t records[SESSION_LOG_READ_RECORDS];
+  SessionDaysHeader_t header;
+  SessionDay_t *days = NULL;
+  struct stat sb;
+  int n_days = 0;
+  int error = NO_ERROR;
+  int fd = open_log(log_path, O_RDWR, F_WRLCK);
+  if ((fd < 0 && errno != ENOENT) || (fd >= 0 && fstat(fd, &sb) != 0))
+    error = ERROR;
+  if (error == NO_ERROR)
+    error = read_days(days_path, &header, &days, &n_days);
+  if (error == NO_ERROR && fd >= 0) {
+    int capacity = n_days;
+    off_t offset = (header.log_ino == (uint64_t)sb.st_ino &&
+                    header.log_offset <= sb.st_size)
+                       ? (off_t)header.log_offset
+                       : 0;
+    ssize_t n = (lseek(fd, offset, SEEK_SET) == offset) ? 1 : -1;
+    while (error == NO_ERROR && n > 0 &&
+           (n = read(fd, records, sizeof(records))) > 0) {
+      int count = n / sizeof(*records);
+      for (int i = 0; error == NO_ERROR && i < count; i++)
+        error = add_record(&days, &n_days, &capacity, &records[i]);
+      offset += count * (off_t)sizeof(*records);
+    }
+    header.log_ino = sb.st_ino;
+    header.log_offset = offset;
+    if (error == NO_ERROR && n == 0)
+      error = write_days(days_path, &header, days, n_days);
+    else
+      error = ERROR;
+    if (error == NO_ERROR) error = replace_log(log_path);
+  }
+  if (fd >= 0) close(fd);
+  free(days);
+  return (error == NO_ERROR) ? n_days : -1;
+}
+
+/**
+ * @brief print per-day summaries: date, games, best and average score, best
+ * level, clears by rows, pieces, time played and inputs per minute
+ * @param[in] days_path file path of per-day summaries
+ * @param[in] out output stream
+ * @return number of days, -1 if the file cannot be read
+ */
+int session_log_print(char const *days_path, FILE *out) {
+  SessionDaysHeader_t header;
+  SessionDay_t *days = NULL;
+  int n_days = 0;
+  int error = read_days(days_path, &header, &days, &n_days);
+  for (int i = 0; error == NO_ERROR && i < n_days; i++) {
+    SessionDay_t const *d = &days[i];
+    time_t t = (time_t)(d->day * SESSION_DAY_SECONDS);
+    struct tm tm;
+    char date[16] = "";
+    if (gmtime_r(&t, &tm)) strftime(date, sizeof(date), "%Y-%m-%d", &tm);
+    fprintf(out,
+            "%s games %4d best %7d avg %7lld level %2d clears %d/%d/%d/%d "
+            "pieces %6d time %5lldm ipm %4lld\n",
+            date, d->games, d->best_score,
+            (long long)(d->total_score / d->games), d->best_level,
+            d->clears[0], d->clears[1], d->clears[2], d->clears[3],
+            d->pieces, (long long)(d->duration_ms / 60000),
+            (long long)((d->duration_ms > 0)
+                            ? d->inputs * 60000 / d->duration_ms
+                            : 0));
+  }
+  free(days);
+  return (error == NO_ERROR) ? n_days : -1;
+}
+
+/**
+ * @brief append finished current game to the session log, compact the log
+ * once it holds SESSION_LOG_COMPACT_RECORDS records
+ * @return error code
+ */
+int session_log_record(void) {
+  GameState_t *game = updateGameState();
+  int error = NO_ERROR;
+  if (game->pieces > 0) {
+    int64_t played = play_time_ms();
+    SessionRecord_t record = {
+        .end_time = time(NULL),
+        .seed = game->start_seed,
+        .score = game->score,
+        .level = game->level,
+        .pieces = game->pieces,
+        .duration_ms = (int32_t)played,
+        .inputs_per_min =
+            (played > 0) ? (int32_t)(game->inputs * 60000LL / played) : 0};
+    for (int i = 0; i < 4; i++) record.clears[i] = game->clears[i];
+    SessionLog_t *log = updateSessionLog();
+    int n = session_log_append(log->log_path, &record);
+    if (n >= SESSION_LOG_COMPACT_RECORDS &&
+        session_log_compact(log->log_path, log->days_path) < 0)
+      n = -1;
+    if (n < 0) error = ERROR;
+  }
+  return error;
+}
+
+/**
+ * @brief read header and all per-day summaries, missing file has none
+ * @param[in] path file path of per-day summaries
+ * @param[out] header header, nothing compacted for a missing file
+ * @param[out] days summaries, allocated, NULL if there are none
+ * @param[out] n_days number of days
+ * @return error code
+ */
+static int read_days(char const *path, SessionDaysHeader_t *header,
+                     SessionDay_t **days, int *n_days) {
+  struct stat sb;
+  int error = NO_ERROR;
+  int fd = open(path, O_RDONLY);
+  ssize_t size = 0;
+  *header = (SessionDaysHeader_t){.magic = SESSION_DAYS_MAGIC, .version = 1};
+  *days = NULL;
+  *n_days = 0;
+  if (fd >= 0) {
+    if (fstat(fd, &sb) == 0 && sb.st_size >= (off_t)sizeof(*header) &&
+        (sb.st_size - sizeof(*header)) % sizeof(SessionDay_t) == 0 &&
+        read(fd, header, sizeof(*header)) == sizeof(*header) &&
+        header->magic == SESSION_DAYS_MAGIC && header->version == 1) {
+      size = sb.st_size - sizeof(*header);
+      if (size > 0) *days = malloc(size);
+      if (size > 0 && (*days == NULL || read(fd, *days, size) != size))
+        error = ERROR;
+      else
+        *n_days = size / sizeof(SessionDay_t);
+    } else {
+      error = ERROR;
+    }
+    close(fd);
+  } else if (errno != ENOENT) {
+    error = ERROR;
+  }
+  return error;
+}
+
+/**
+ * @brief add record to summary of its day, found with a binary search, new
+ * day is inserted in order
+ * @param[in,out] days summaries sorted by day, reallocated when full
+ * @param[in,out] n_days number of days
+ * @param[in,out] capacity number of days allocated
+ * @param[in] record record
+ * @return error code
+ */
+static int add_record(SessionDay_t **days, int *n_days, int *capacity,
+                      SessionRecord_t const *record) {
+  int64_t day = record->end_time / SESSION_DAY_SECONDS;
+  int lo = 0;
+  int hi = *n_days;
+  int error = NO_ERROR;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if ((*days)[mid].day < day)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == *n_days || (*days)[lo].day != day) {
+    if (*n_days == *capacity) {
+      SessionDay_t *grown =
+          realloc(*days, (*capacity * 2 + 16) * sizeof(SessionDay_t));
+      if (grown) {
+        *days = grown;
+        *capacity = *capacity * 2 + 16;
+      } else {
+        error = ERROR;
+      }
+    }
+    if (error == NO_ERROR) {
+      memmove(*days + lo + 1, *days + lo,
+              (*n_days - lo) * sizeof(SessionDay_t));
+      (*days)[lo] = (SessionDay_t){.day = day};
+      (*n_days)++;
+    }
+  }
+  if (error == NO_ERROR) {
+    SessionDay_t *d = *days + lo;
+    d->games++;
+    d->total_score += record->score;
+    if (record->score > d->best_score) d->best_score = record->score;
+    if (record->level > d->best_level) d->best_level = record->level;
+    for (int i = 0; i < 4; i++) d->clears[i] += record->clears[i];
+    d->pieces += record->pieces;
+    d->duration_ms += record->duration_ms;
+    d->inputs += (int64_t)record->inputs_per_min * record->duration_ms / 60000;
+  }
+  return error;
+}
+
+/**
+ * @brief write header and summaries to temporary file next to path and rename
+ * it into place, so path never has a partial file
+ * @param[in] path file path of per-day summaries
+ * @param[in] header header with compacted log and offset
+ * @param[in] days summaries
+ * @param[in] n_days number of days
+ * @return error code
+ */
+static int write_days(char const *path, SessionDaysHeader_t const *header,
+                      SessionDay_t const *days, int n_days) {
+  char tmp[256];
+  int error = ERROR;
+  ssize_t size = n_days * (ssize_t)sizeof(SessionDay_t);
+  if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) < (int)sizeof(tmp)) {
+    int fd = mkstemp(tmp);
+    if (fd >= 0) {
+      if (fchmod(fd, 0644) == 0 &&
+          write(fd, header, sizeof(*header)) == sizeof(*header) &&
+          (size == 0 || write(fd, days, size) == size) && fsync(fd) == 0 &&
+          rename(tmp, path) == 0)
+        error = NO_ERROR;
+      close(fd);
+      if (error) unlink(tmp);
+    }
+  }
+  return error;
+}
+
+/**
+ * @brief open the log and take its lock. Log replaced by compaction while
+ * waiting for the lock is opened again, so nothing is written to or read from
+ * a log that is no longer at path
+ * @param[in] path file path of the session log
+ * @param[in] flags open flags
+ * @param[in] type F_RDLCK or F_WRLCK
+ * @return locked file, -1 on error (errno ENOENT: no log without O_CREAT)
+ */
+static int open_log(char const *path, int flags, short type) {
+  struct stat fsb, psb;
+  int fd = -1;
+  int reopen = true;
+  while (reopen) {
+    reopen = false;
+    fd = open(path, flags, 0644);
+    if (fd >= 0 && (lock_file(fd, type) != 0 || fstat(fd, &fsb) != 0)) {
+      close(fd);
+      fd = -1;
+    } else if (fd >= 0 && (stat(path, &psb) != 0 || psb.st_ino != fsb.st_ino ||
+                           psb.st_dev != fsb.st_dev)) {
+      close(fd);
+      fd = -1;
+      reopen = true;
+    }
+  }
+  return fd;
+}
+
+/**
+ * @brief rename new empty file into place of the log. Compacted log stays
+ * open until compaction ends, so the new log never gets its inode
+ * @param[in] path file path of the session log
+ * @return error code
+ */
+static int replace_log(char const *path) {
+  char tmp[256];
+  int error = ERROR;
+  if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) < (int)sizeof(tmp)) {
+    int fd = mkstemp(tmp);
+    if (fd >= 0) {
+      if (fchmod(fd, 0644) == 0 && rename(tmp, path) == 0) error = NO_ERROR;
+      close(fd);
+      if (error) unlink(tmp);
+    }
+  }
+  return error;
+}
+
+/**
+ * @brief take or release advisory lock of the whole file, waits for other
+ * instances holding it
+ * @param[in] fd file
+ * @param[in] type F_RDLCK, F_WRLCK or F_UNLCK
+ * @return 0 on success, -1 on error
+ */
+static int lock_file(int fd, short type) {
+  struct flock lock = {.l_type = type, .l_whence = SEEK_SET};
+  int rc = fcntl(fd, F_SETLKW, &lock);
+  while (rc != 0 && errno == EINTR) rc = fcntl(fd, F_SETLKW, &lock);
+  return rc;
+}
@@ -11,19 +11,70 @@
 #include "../../include/tetris.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
+static int compact_sessions(void);
+
 /**
  * @brief Main entry point of the Tetris game
+ * @param argc Number of arguments
+ * @param argv Arguments: --versus PATH starts versus mode on socket PATH,
+ * --broadcast PATH streams board to spectators connecting to socket PATH,
+ * --netplay PATH starts lockstep netplay on socket PATH, --compact-sessions
+ * alone compacts the session log and prints per-day summaries instead
  * @return int Returns NO_ERROR (0) on successful execution
  *
- * @details Starts the main game loop
+ * @details Starts the main game loop. Counters of state machine and engine are
+ * dumped as JSON to perf_dump_path() on SIGUSR1 and on exit, with TRACE=1 the
+ * event trace is exported to trace_path() on SIGUSR2 and on exit. If versus,
+ * netplay or broadcast socket cannot be created, the game shows the error
+ * banner
  */
-int main(void) {
-  int error = init_game();
-  if (error == NO_ERROR) {
-    game_loop();
+int main(int argc, char *argv[]) {
+  int compact = argc == 2 && strcmp(argv[1], SESSION_COMPACT_OPTION) == 0;
+  char const *versus_path = NULL;
+  char const *broadcast_path = NULL;
+  for (int i = 1; i + 1 < argc; i++) {
+    if (strcmp(argv[i], VERSUS_OPTION) == 0) {
+      versus_path = argv[++i];
+    } else if (strcmp(argv[i], BROADCAST_OPTION) == 0) {
+      broadcast_path = argv[++i];
+    } else if (strcmp(argv[i], NETPLAY_OPTION) == 0) {
+      versus_path = argv[++i];
+      updateNetplay()->enabled = true;
+    }
+  }
+  int error = (compact) ? compact_sessions() : init_game();
+  if (error == NO_ERROR && versus_path && versus_init(versus_path) != NO_ERROR)
+    *updateTetrisState() = EXIT_ERROR;
+  if (error == NO_ERROR && broadcast_path &&
+      broadcast_init(broadcast_path) != NO_ERROR)
+    *updateTetrisState() = EXIT_ERROR;
+  if (error == NO_ERROR && !compact) {
+    perf_install_dump_signal();
+    TRACE_INSTALL_SIGNAL();
+    if (updateNetplay()->enabled && *updateTetrisState() != EXIT_ERROR)
+      netplay_loop();
+    else
+      game_loop();
     exit_game();
+    if (PERF_STATS) perf_dump(perf_dump_path());
+    TRACE_EXPORT();
   }
   return error;
 }
+
+/**
+ * @brief compact session log into per-day summaries and print them
+ *
+ * @return error code
+ */
+static int compact_sessions(void) {
+  SessionLog_t *log = updateSessionLog();
+  int error = NO_ERROR;
+  if (session_log_compact(log->log_path, log->days_path) < 0 ||
+      session_log_print(log->days_path, stdout) < 0)
+    error = ERROR;
+  return error;
+}
@@ -0,0 +1,167 @@
+/**
+ * @file trace.c
+ * @brief Event trace ring buffers with Chrome trace export
+ * @details This file implements per-thread ring buffers of trace events and
+ * their export as Chrome trace JSON. Compiled only with TRACE=1.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../../include/tetris.h"
+
+#if TRACE
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * @brief Names of events in trace export, indexed by TraceId_t
+ */
+static char const *const trace_names[TRACE_IDS] = {"state", "render", "input",
+                                                   "high_score_io"};
+
+/**
+ * @brief Ring buffers of all threads, exported together
+ */
+static TraceRing_t *rings[TRACE_THREADS] = {0};
+
+/**
+ * @brief Number of ring buffer slots taken, may exceed TRACE_THREADS
+ */
+static atomic_int n_rings = 0;
+
+/**
+ * @brief Ring buffer of calling thread, NULL until its first event
+ */
+static _Thread_local TraceRing_t *thread_ring = NULL;
+
+/**
+ * @brief 1 if calling thread got no ring buffer, its events are dropped
+ */
+static _Thread_local int thread_dropped = 0;
+
+/**
+ * @brief Set by SIGUSR2 handler, trace export is requested
+ */
+static volatile sig_atomic_t export_requested = 0;
+
+static TraceRing_t *new_ring(void);
+static void on_export_signal(int sig);
+
+/**
+ * @brief record event in ring buffer of calling thread, overwrite the oldest
+ * event when the ring is full
+ * @param[in] id event
+ * @param[in] type Chrome trace phase: 'B' - begin, 'E' - end
+ * @param[in] arg event argument
+ */
+void trace_record(TraceId_t id, char type, int arg) {
+  TraceRing_t *ring = thread_ring;
+  if (ring == NULL && !thread_dropped) ring = thread_ring = new_ring();
+  if (ring) {
+    TraceEvent_t *ev = &ring->events[ring->head & (TRACE_EVENTS - 1)];
+    ev->ts = monotonic_ns();
+    ev->arg = arg;
+    ev->id = (uint16_t)id;
+    ev->type = (uint16_t)type;
+    ring->head++;
+  }
+}
+
+/**
+ * @brief write events of all ring buffers as Chrome trace JSON, oldest event
+ * of each ring first
+ * @param[in] path file path
+ * @return error code
+ */
+int trace_export(char const *path) {
+  int error = NO_ERROR;
+  FILE *out = fopen(path, "w");
+  if (out) {
+    int n = atomic_load(&n_rings);
+    int first = 1;
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    for (int i = 0; i < n && i < TRACE_THREADS; i++) {
+      TraceRing_t const *ring = rings[i];
+      uint32_t head = (ring) ? ring->head : 0;
+      uint32_t j = (head > TRACE_EVENTS) ? head - TRACE_EVENTS : 0;
+      for (; j < head; j++, first = 0) {
+        TraceEvent_t const *ev = &ring->events[j & (TRACE_EVENTS - 1)];
+        fprintf(out,
+                "%s\n  {\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %lld.%03lld, "
+                "\"pid\": %d, \"tid\": %d, \"args\": {\"arg\": %d}}",
+                (first) ? "" : ",", trace_names[ev->id], ev->type,
+                (long long)(ev->ts / 1000), (long long)(ev->ts % 1000),
+                (int)getpid(), ring->tid, (int)ev->arg);
+      }
+    }
+    fprintf(out, "\n]}\n");
+    if (fclose(out) != 0) error = ERROR;
+  } else {
+    error = ERROR;
+  }
+  return error;
+}
+
+/**
+ * @brief path of trace export: environment variable TRACE_ENV if it is set,
+ * TRACE_FILE otherwise
+ * @return file path
+ */
+char const *trace_path(void) {
+  char const *path = getenv(TRACE_ENV);
+  return (path && *path) ? path : TRACE_FILE;
+}
+
+/**
+ * @brief install SIGUSR2 handler requesting trace export
+ * @return error code
+ */
+int trace_install_export_signal(void) {
+  struct sigaction sa = {0};
+  sa.sa_handler = on_export_signal;
+  sigemptyset(&sa.sa_mask);
+  return (sigaction(SIGUSR2, &sa, NULL) == 0) ? NO_ERROR : ERROR;
+}
+
+/**
+ * @brief write trace export if SIGUSR2 was received since previous call
+ */
+void trace_poll_export(void) {
+  if (export_requested) {
+    export_requested = 0;
+    trace_export(trace_path());
+  }
+}
+
+/**
+ * @brief take ring buffer slot for calling thread and allocate its ring. The
+ * ring lives until exit, export may read it after the thread is gone
+ * @return ring buffer, NULL if all slots are taken or allocation failed
+ */
+static TraceRing_t *new_ring(void) {
+  TraceRing_t *ring = NULL;
+  int slot = atomic_fetch_add(&n_rings, 1);
+  if (slot < TRACE_THREADS) ring = calloc(1, sizeof(TraceRing_t));
+  if (ring) {
+    ring->tid = slot + 1;
+    rings[slot] = ring;
+  } else {
+    thread_dropped = 1;
+  }
+  return ring;
+}
+
+/**
+ * @brief SIGUSR2 handler: only sets the flag, export is written by game loop
+ * @param[in] sig signal number (unused)
+ */
+static void on_export_signal(int sig) {
+  (void)sig;
+  export_requested = 1;
+}
+
+#endif /* TRACE */
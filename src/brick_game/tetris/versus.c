@@ -0,0 +1,466 @@
+/**
+ * @file versus.c
+ * @brief Two-player versus mode over a Unix domain socket
+ * @details This file implements connection of two games over a non-blocking
+ * Unix domain socket watched by the event loop, encoding of fixed size
+ * messages and garbage rows exchange with static object of versus mode state.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../include/tetris.h"
+
+static int connect_peer(char const *path);
+static int listen_peer(char const *path);
+static void set_nonblocking(int fd);
+static void accept_peer(Versus_t *vs);
+static void start_netplay(void);
+static void read_peer(Versus_t *vs);
+static int apply_message(Versus_t *vs, VersusMsg_t msg);
+static int queue_message(Versus_t *vs, VersusMsg_t msg);
+static void evict_messages(Versus_t *vs);
+static void flush_peer(Versus_t *vs);
+static void write_peer(Versus_t *vs);
+static void disconnect_peer(Versus_t *vs);
+static void print_versus_stats(void);
+
+/**
+ * @brief Keeps static object: versus mode state
+ *
+ * @return Pointer to versus mode state
+ */
+Versus_t *updateVersus(void) {
+  static Versus_t vs = {.listen_fd = -1, .fd = -1};
+  return &vs;
+}
+
+/**
+ * @brief connect to the peer listening on path, or listen on path if nobody
+ * does. Stale socket path left by a crashed game is removed. Update versus
+ * mode state
+ * @param[in] path socket path
+ * @return error code
+ */
+int versus_init(char const *path) {
+  Versus_t *vs = updateVersus();
+  int error = ERROR;
+  *vs = (Versus_t){.listen_fd = -1, .fd = -1};
+  if (strlen(path) < sizeof(vs->path) &&
+      strlen(path) < sizeof(((struct sockaddr_un *)0)->sun_path)) {
+    strcpy(vs->path, path);
+    signal(SIGPIPE, SIG_IGN); /**< Closed peer is reported by write */
+    vs->fd = connect_peer(path);
+    if (vs->fd >= 0)
+      error = events_watch(vs->fd, versus_on_ready);
+    else if ((vs->listen_fd = listen_peer(path)) >= 0)
+      error = events_watch(vs->listen_fd, versus_on_ready);
+  }
+  vs->active = (error == NO_ERROR);
+  if (error) versus_free();
+  return error;
+}
+
+/**
+ * @brief close sockets, listening side removes socket path. Update versus
+ * mode state
+ */
+void versus_free(void) {
+  Versus_t *vs = updateVersus();
+  if (vs->listen_fd >= 0) {
+    events_unwatch(vs->listen_fd);
+    close(vs->listen_fd);
+    unlink(vs->path);
+  }
+  if (vs->fd >= 0) {
+    flush_peer(vs);
+    disconnect_peer(vs);
+  }
+  *vs = (Versus_t){.listen_fd = -1, .fd = -1};
+}
+
+/**
+ * @brief connect to socket path
+ * @param[in] path socket path
+ * @return non-blocking socket, -1 if nobody listens there
+ */
+static int connect_peer(char const *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  strcpy(addr.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+    if (errno == ECONNREFUSED) unlink(path); /**< Nobody listens: stale */
+    close(fd);
+    fd = -1;
+  }
+  if (fd >= 0) set_nonblocking(fd);
+  return fd;
+}
+
+/**
+ * @brief listen on socket path for one peer
+ * @param[in] path socket path
+ * @return non-blocking listening socket, -1 on error
+ */
+static int listen_peer(char const *path) {
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  strcpy(addr.sun_path, path);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd >= 0 && (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+                  listen(fd, 1) != 0)) {
+    close(fd);
+    fd = -1;
+  }
+  if (fd >= 0) set_nonblocking(fd);
+  return fd;
+}
+
+/**
+ * @brief switch descriptor to non-blocking mode
+ * @param[in] fd descriptor
+ */
+static void set_nonblocking(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+/**
+ * @brief write message as type, arg, value and data, little-endian
+ * @param[in] msg message
+ * @param[out] buf VERSUS_MSG_SIZE bytes
+ */
+void versus_encode(VersusMsg_t msg, uint8_t *buf) {
+  buf[0] = msg.type;
+  buf[1] = msg.arg;
+  buf[2] = (uint8_t)msg.value;
+  buf[3] = (uint8_t)(msg.value >> 8);
+  for (int i = 0; i < 4; i++) buf[4 + i] = (uint8_t)(msg.data >> (8 * i));
+}
+
+/**
+ * @brief read message written by versus_encode()
+ * @param[in] buf VERSUS_MSG_SIZE bytes
+ * @return message
+ */
+VersusMsg_t versus_decode(uint8_t const *buf) {
+  VersusMsg_t msg = {buf[0], buf[1], (uint16_t)(buf[2] | buf[3] << 8), 0};
+  for (int i = 0; i < 4; i++) msg.data |= (uint32_t)buf[4 + i] << (8 * i);
+  return msg;
+}
+
+/**
+ * @brief queue message and send queued messages without blocking. If the peer
+ * does not read and the queue is full, queued inputs and digests make room for
+ * seed, garbage, game over and lockstep input: the next inputs and digests
+ * supersede them. Garbage and game over that still find no room are kept
+ * aside and queued by a later flush. Update versus mode state
+ * @param[in] msg message
+ */
+void versus_send(VersusMsg_t msg) {
+  Versus_t *vs = updateVersus();
+  if (vs->fd >= 0) {
+    int aside = vs->unsent_garbage > 0 && (msg.type == VERSUS_MSG_GARBAGE ||
+                                           msg.type == VERSUS_MSG_GAMEOVER);
+    if (aside || queue_message(vs, msg) != NO_ERROR) {
+      if (msg.type == VERSUS_MSG_GARBAGE)
+        vs->unsent_garbage += msg.arg;
+      else if (msg.type == VERSUS_MSG_GAMEOVER)
+        vs->unsent_over = 1;
+      else
+        vs->dropped++;
+    }
+    flush_peer(vs);
+  }
+}
+
+/**
+ * @brief append message to send queue, evict queued inputs and digests for any
+ * other message if the queue is full. Update versus mode state
+ * @param[in] msg message
+ * @return ERROR if there is no room
+ */
+static int queue_message(Versus_t *vs, VersusMsg_t msg) {
+  int error = NO_ERROR;
+  if (vs->tx_len + VERSUS_MSG_SIZE > VERSUS_TX_SIZE &&
+      msg.type != VERSUS_MSG_INPUT && msg.type != VERSUS_MSG_DIGEST)
+    evict_messages(vs);
+  if (vs->tx_len + VERSUS_MSG_SIZE <= VERSUS_TX_SIZE) {
+    versus_encode(msg, vs->tx + vs->tx_len);
+    vs->tx_len += VERSUS_MSG_SIZE;
+  } else {
+    error = ERROR;
+  }
+  return error;
+}
+
+/**
+ * @brief drop queued inputs and digests, keep order of other messages. Head of
+ * the queue may be the tail of a partly written message, it stays. Update
+ * versus mode state
+ */
+static void evict_messages(Versus_t *vs) {
+  int len = vs->tx_len % VERSUS_MSG_SIZE;
+  for (int off = len; off < vs->tx_len; off += VERSUS_MSG_SIZE) {
+    if (vs->tx[off] == VERSUS_MSG_INPUT || vs->tx[off] == VERSUS_MSG_DIGEST) {
+      vs->dropped++;
+    } else {
+      memmove(vs->tx + len, vs->tx + off, VERSUS_MSG_SIZE);
+      len += VERSUS_MSG_SIZE;
+    }
+  }
+  vs->tx_len = len;
+}
+
+/**
+ * @brief send what the socket accepts now, queue garbage and game over kept
+ * aside once there is room and send them too. Update versus mode state
+ */
+static void flush_peer(Versus_t *vs) {
+  write_peer(vs);
+  while (vs->fd >= 0 && vs->unsent_garbage > 0 &&
+         vs->tx_len + VERSUS_MSG_SIZE <= VERSUS_TX_SIZE) {
+    int rows = vs->unsent_garbage > UINT8_MAX ? UINT8_MAX : vs->unsent_garbage;
+    queue_message(vs, (VersusMsg_t){VERSUS_MSG_GARBAGE, (uint8_t)rows, 0, 0});
+    vs->unsent_garbage -= rows;
+    write_peer(vs);
+  }
+  if (vs->fd >= 0 && vs->unsent_over && vs->unsent_garbage == 0 &&
+      queue_message(vs, (VersusMsg_t){VERSUS_MSG_GAMEOVER, 0, 0, 0}) ==
+          NO_ERROR) {
+    vs->unsent_over = 0;
+    write_peer(vs);
+  }
+}
+
+/**
+ * @brief send queued bytes the socket accepts now, the rest waits for the
+ * next flush. Update versus mode state
+ */
+static void write_peer(Versus_t *vs) {
+  while (vs->fd >= 0 && vs->tx_len > 0) {
+    ssize_t n = write(vs->fd, vs->tx, vs->tx_len);
+    if (n > 0) {
+      vs->tx_len -= (int)n;
+      memmove(vs->tx, vs->tx + n, vs->tx_len);
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    } else {
+      disconnect_peer(vs);
+    }
+  }
+}
+
+/**
+ * @brief handler of versus sockets: accept peer on listening socket, read
+ * messages of connected peer. Update versus mode state
+ * @param[in] fd readable socket
+ * @return ESCAPE if peer game is over, INPUT_NONE otherwise
+ */
+int versus_on_ready(int fd) {
+  Versus_t *vs = updateVersus();
+  int over = vs->peer_over;
+  if (fd == vs->listen_fd)
+    accept_peer(vs);
+  else if (fd == vs->fd)
+    read_peer(vs);
+  if (vs->fd >= 0) flush_peer(vs);
+  return (vs->peer_over && !over) ? ESCAPE : INPUT_NONE;
+}
+
+/**
+ * @brief take connected peer, stop listening: only one peer plays. Update
+ * versus mode state
+ */
+static void accept_peer(Versus_t *vs) {
+  int fd = accept(vs->listen_fd, NULL, NULL);
+  if (fd >= 0) {
+    set_nonblocking(fd);
+    events_unwatch(vs->listen_fd);
+    close(vs->listen_fd);
+    unlink(vs->path);
+    vs->listen_fd = -1;
+    vs->fd = fd;
+    if (events_watch(fd, versus_on_ready) != NO_ERROR) disconnect_peer(vs);
+    if (vs->fd >= 0 && updateNetplay()->enabled) start_netplay();
+  }
+}
+
+/**
+ * @brief pick seed of both netplay games, send it to the peer and start
+ * netplay as player 0
+ */
+static void start_netplay(void) {
+  uint32_t seed = (uint32_t)time(NULL) ^ (uint32_t)monotonic_ns();
+  versus_send((VersusMsg_t){VERSUS_MSG_SEED, 0, 0, seed});
+  netplay_start(updateNetplay(), seed, 0);
+}
+
+/**
+ * @brief read what the socket has, apply whole messages, keep partial one.
+ * Peer is disconnected when it closes the socket. Update versus mode state
+ */
+static void read_peer(Versus_t *vs) {
+  ssize_t n = read(vs->fd, vs->rx + vs->rx_len, VERSUS_RX_SIZE - vs->rx_len);
+  if (n > 0) {
+    int len = vs->rx_len + (int)n;
+    int off = 0;
+    int changed = 0;
+    for (; len - off >= VERSUS_MSG_SIZE; off += VERSUS_MSG_SIZE)
+      changed |= apply_message(vs, versus_decode(vs->rx + off));
+    vs->rx_len = len - off;
+    memmove(vs->rx, vs->rx + off, vs->rx_len);
+    if (changed) print_versus_stats();
+  } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+    disconnect_peer(vs);
+  }
+}
+
+/**
+ * @brief apply message of the peer. Update versus mode state
+ * @param[in] msg message
+ * @return 1 if shown versus stats changed
+ */
+static int apply_message(Versus_t *vs, VersusMsg_t msg) {
+  int changed = 1;
+  if (msg.type == VERSUS_MSG_INPUT) {
+    vs->peer_inputs++;
+    changed = 0;
+  } else if (msg.type == VERSUS_MSG_GARBAGE) {
+    vs->pending_garbage += msg.arg;
+    if (vs->pending_garbage > ROWS_MAP) vs->pending_garbage = ROWS_MAP;
+  } else if (msg.type == VERSUS_MSG_DIGEST) {
+    vs->peer_height = msg.value;
+    vs->peer_digest = msg.data;
+  } else if (msg.type == VERSUS_MSG_GAMEOVER) {
+    vs->peer_over = 1;
+  } else if (msg.type == VERSUS_MSG_SEED) {
+    netplay_start(updateNetplay(), msg.data, 1);
+  } else if (msg.type == VERSUS_MSG_LOCKSTEP) {
+    netplay_remote_input(updateNetplay(), msg);
+    changed = 0;
+  } else {
+    changed = 0;
+  }
+  return changed;
+}
+
+/**
+ * @brief close peer socket, game goes on alone. Update versus mode state
+ */
+static void disconnect_peer(Versus_t *vs) {
+  events_unwatch(vs->fd);
+  close(vs->fd);
+  vs->fd = -1;
+  vs->tx_len = 0;
+  vs->rx_len = 0;
+  vs->unsent_garbage = 0;
+  vs->unsent_over = 0;
+}
+
+/**
+ * @brief send action of local player
+ * @param[in] action action
+ */
+void versus_send_input(UserAction_t action) {
+  versus_send((VersusMsg_t){VERSUS_MSG_INPUT, (uint8_t)action, 0, 0});
+}
+
+/**
+ * @brief garbage of cleared rows cancels pending garbage first, the rest is
+ * sent to the peer. Update versus mode state
+ * @param[in] n_rows number of rows cleared
+ */
+void versus_rows_cleared(int n_rows) {
+  Versus_t *vs = updateVersus();
+  int rows = versus_garbage_for(n_rows);
+  int cancel = (rows < vs->pending_garbage) ? rows : vs->pending_garbage;
+  vs->pending_garbage -= cancel;
+  rows -= cancel;
+  if (rows > 0 && vs->fd >= 0) {
+    versus_send((VersusMsg_t){VERSUS_MSG_GARBAGE, (uint8_t)rows, 0, 0});
+    vs->sent_garbage += rows;
+  }
+}
+
+/**
+ * @brief insert pending garbage into the field, send field digest. Update
+ * versus mode state and game state field
+ */
+void versus_figure_locked(void) {
+  Versus_t *vs = updateVersus();
+  if (vs->active) {
+    insert_garbage_rows(vs->pending_garbage);
+    vs->pending_garbage = 0;
+    int height = versus_stack_height(updateGameState());
+    versus_send((VersusMsg_t){VERSUS_MSG_DIGEST, 0, (uint16_t)height,
+                              versus_field_digest()});
+    print_versus_stats();
+  }
+}
+
+/**
+ * @brief tell the peer local game is over
+ */
+void versus_game_over(void) {
+  versus_send((VersusMsg_t){VERSUS_MSG_GAMEOVER, 0, 0, 0});
+}
+
+/**
+ * @brief garbage rows of a clear: single sends nothing, tetris sends 4
+ * @param[in] n_rows number of rows cleared
+ * @return garbage rows
+ */
+int versus_garbage_for(int n_rows) {
+  static int const garbage[] = {0, 0, 1, 2, 4};
+  return (n_rows >= 0 && n_rows <= 4) ? garbage[n_rows] : 4;
+}
+
+/**
+ * @brief FNV-1a digest of visible field cells
+ * @return digest
+ */
+uint32_t versus_field_digest(void) {
+  GameState_t *st = updateGameState();
+  uint32_t hash = 2166136261u;
+  for (int i = HIDDEN_ROWS; i < FIELD_ROWS; i++)
+    for (int j = 0; j < COLS_MAP; j++) {
+      hash ^= st->field[i][j];
+      hash *= 16777619u;
+    }
+  return hash;
+}
+
+/**
+ * @brief height of the stack: visible rows from the bottom to the highest
+ * filled cell
+ * @param[in] st game
+ * @return number of rows
+ */
+int versus_stack_height(GameState_t const *st) {
+  int height = 0;
+  for (int i = FIELD_ROWS - 1; i >= HIDDEN_ROWS; i--)
+    for (int j = 0; j < COLS_MAP; j++)
+      if (CELL_FILLED(st->field[i][j])) height = FIELD_ROWS - i;
+  return height;
+}
+
+/**
+ * @brief show peer stack height and pending garbage while game is running
+ *
+ * @note USE_MOCK used for frontend stubs for unit tests of logic
+ */
+static void print_versus_stats(void) {
+#ifndef USE_MOCK
+  TetrisState_t state = *updateTetrisState();
+  if (state != START && state != GAMEOVER && state != EXIT_ERROR)
+    print_stats();
+#endif
+}
@@ -0,0 +1,470 @@
+/**
+ * @file ansi_term.c
+ * @brief Minimal terminal layer of raw ANSI renderer
+ * @details Implements the subset of ncurses interface used by the game with
+ * termios, poll and raw escape sequences: terminal setup and restore, input
+ * with timeout and arrow keys decoding, windows as regions of one screen
+ * buffer, frame output of changed cells with a single write(2).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "../../include/tetris.h"
+
+/**
+ * @brief Maximum number of bytes sent for one cell: cursor move, color,
+ * character set and the character
+ */
+#define CELL_OUT_MAX 24
+
+/**
+ * @brief Number of color pairs (8 bits of chtype)
+ */
+#define ANSI_PAIRS 256
+
+/**
+ * @brief Screen buffers and state of the terminal
+ */
+typedef struct {
+  chtype back[ANSI_LINES][ANSI_COLS];  /**< Screen drawn by windows */
+  chtype front[ANSI_LINES][ANSI_COLS]; /**< Screen shown by the terminal */
+  short colors[ANSI_PAIRS];            /**< Foreground of color pairs */
+  chtype attrs;  /**< Color pair and charset the terminal is set to */
+  int y;         /**< Terminal cursor row */
+  int x;         /**< Terminal cursor column */
+  char out[ANSI_LINES * ANSI_COLS * CELL_OUT_MAX]; /**< Frame output */
+} Screen_t;
+
+/**
+ * @brief Whole terminal window
+ */
+static WINDOW screen_win = {0, 0, ANSI_LINES, ANSI_COLS, -1, 0, 0};
+
+/**
+ * @brief Standard screen pointer
+ */
+WINDOW *stdscr = &screen_win;
+
+/**
+ * @brief Keeps static object: terminal mode saved by initscr()
+ *
+ * @return Pointer to saved terminal mode
+ */
+static struct termios *updateSavedMode(void) {
+  static struct termios mode = {0};
+  return &mode;
+}
+
+/**
+ * @brief Keeps static object: screen buffers and state of the terminal
+ *
+ * @return Pointer to screen
+ */
+static Screen_t *updateScreen(void) {
+  static Screen_t screen = {0};
+  return &screen;
+}
+
+/**
+ * @brief Writes escape sequence to the terminal
+ * @param seq Escape sequence
+ */
+static void put_seq(char const *seq) {
+  ssize_t rc = write(STDOUT_FILENO, seq, strlen(seq));
+  (void)rc;
+}
+
+/**
+ * @brief Waits for input
+ * @param ms Time to wait (ms), negative - wait forever
+ * @return int 1 if input is ready, 0 on timeout
+ */
+static int wait_input(int ms) {
+  struct pollfd pfd = {STDIN_FILENO, POLLIN, 0};
+  return poll(&pfd, 1, ms) > 0;
+}
+
+/**
+ * @brief Decodes the rest of escape sequence after ESC
+ * @details ESC [ A..D and ESC O A..D are arrow keys, anything else is ESCAPE
+ *
+ * @return int Key code
+ */
+static int read_escape(void) {
+  static int const arrows[] = {KEY_UP, KEY_DOWN, KEY_RIGHT, KEY_LEFT};
+  int rc = ESCAPE;
+  unsigned char seq[2] = {0};
+  if (read(STDIN_FILENO, &seq[0], 1) == 1 && (seq[0] == '[' || seq[0] == 'O') &&
+      wait_input(ESCDELAY_MS) && read(STDIN_FILENO, &seq[1], 1) == 1 &&
+      seq[1] >= 'A' && seq[1] <= 'D')
+    rc = arrows[seq[1] - 'A'];
+  return rc;
+}
+
+/**
+ * @brief Saves terminal mode, switches to alternate screen with input without
+ * line buffering
+ *
+ * @return stdscr
+ */
+WINDOW *initscr(void) {
+  struct termios *saved = updateSavedMode();
+  struct termios mode;
+  tcgetattr(STDIN_FILENO, saved);
+  mode = *saved;
+  mode.c_lflag &= ~(tcflag_t)ICANON;
+  mode.c_cc[VMIN] = 1;
+  mode.c_cc[VTIME] = 0;
+  tcsetattr(STDIN_FILENO, TCSANOW, &mode);
+  put_seq("\033[?1049h\033[0m\033(B\033[H\033[2J");
+  Screen_t *screen = updateScreen();
+  for (int i = 0; i < ANSI_LINES; i++)
+    for (int j = 0; j < ANSI_COLS; j++)
+      screen->back[i][j] = screen->front[i][j] = ' ';
+  screen->attrs = 0;
+  screen->y = 0;
+  screen->x = 0;
+  return stdscr;
+}
+
+/**
+ * @brief Restores terminal mode, cursor and main screen
+ *
+ * @return OK
+ */
+int endwin(void) {
+  put_seq("\033[0m\033(B\033[?25h\033[?1049l");
+  tcsetattr(STDIN_FILENO, TCSANOW, updateSavedMode());
+  return OK;
+}
+
+/**
+ * @brief Disables echo of typed characters
+ */
+void noecho(void) {
+  struct termios mode;
+  tcgetattr(STDIN_FILENO, &mode);
+  mode.c_lflag &= ~(tcflag_t)ECHO;
+  tcsetattr(STDIN_FILENO, TCSANOW, &mode);
+}
+
+/**
+ * @brief Hides (0) or shows cursor
+ * @param visibility Cursor visibility setting
+ *
+ * @return OK
+ */
+int curs_set(int visibility) {
+  put_seq((visibility) ? "\033[?25h" : "\033[?25l");
+  return OK;
+}
+
+/**
+ * @brief Arrow keys are always decoded, kept for ncurses compatibility
+ * @param win Window (unused)
+ * @param enable Keypad enable flag (unused)
+ *
+ * @return OK
+ */
+int keypad(WINDOW *win, int enable) {
+  (void)win;
+  (void)enable;
+  return OK;
+}
+
+/**
+ * @brief Sets input timeout of window
+ * @param win Window
+ * @param delay Timeout (ms), negative - blocking input
+ */
+void wtimeout(WINDOW *win, int delay) { win->delay = delay; }
+
+/**
+ * @brief Switches between non-blocking and blocking input
+ * @param win Window
+ * @param enable 1 - non-blocking input, 0 - blocking input
+ *
+ * @return OK
+ */
+int nodelay(WINDOW *win, int enable) {
+  win->delay = (enable) ? 0 : -1;
+  return OK;
+}
+
+/**
+ * @brief Reads one key waiting for input timeout of window
+ * @param win Window
+ *
+ * @return Character, arrow key code or ERR on timeout
+ */
+int wgetch(WINDOW *win) {
+  int rc = ERR;
+  unsigned char c = 0;
+  if (wait_input(win->delay) && read(STDIN_FILENO, &c, 1) == 1) {
+    rc = c;
+    if (c == ESCAPE && wait_input(ESCDELAY_MS)) rc = read_escape();
+  }
+  return rc;
+}
+
+/**
+ * @brief Creates window for screen region
+ * @param nlines Number of rows
+ * @param ncols Number of columns
+ * @param begy Screen Y coordinate of top left corner
+ * @param begx Screen X coordinate of top left corner
+ *
+ * @return New window, NULL if allocation failed
+ */
+WINDOW *newwin(int nlines, int ncols, int begy, int begx) {
+  WINDOW *win = malloc(sizeof(WINDOW));
+  if (win) *win = (WINDOW){begy, begx, nlines, ncols, -1, 0, 0};
+  return win;
+}
+
+/**
+ * @brief Deletes window
+ * @param win Window
+ *
+ * @return OK
+ */
+int delwin(WINDOW *win) {
+  free(win);
+  return OK;
+}
+
+/**
+ * @brief Puts character to window
+ * @param win Window
+ * @param y Y coordinate in window
+ * @param x X coordinate in window
+ * @param ch Character with attributes
+ *
+ * @return OK, ERR if window is NULL or position is outside of window or screen
+ */
+int mvwaddch(WINDOW *win, int y, int x, chtype ch) {
+  int rc = ERR;
+  int sy = (win) ? win->begy + y : -1;
+  int sx = (win) ? win->begx + x : -1;
+  if (win && y >= 0 && x >= 0 && y < win->maxy && x < win->maxx &&
+      sy < ANSI_LINES && sx < ANSI_COLS) {
+    updateScreen()->back[sy][sx] = ch | win->attrs;
+    win->touched = 1;
+    rc = OK;
+  }
+  return rc;
+}
+
+/**
+ * @brief Puts at most n characters of string to window
+ * @param win Window
+ * @param y Y coordinate in window
+ * @param x X coordinate in window
+ * @param str String
+ * @param n Maximum number of characters, -1 - whole string
+ *
+ * @return OK, ERR if position is outside of window or screen
+ */
+int mvwaddnstr(WINDOW *win, int y, int x, char const *str, int n) {
+  int rc = OK;
+  for (int i = 0; str[i] != '\0' && (n < 0 || i < n) && rc == OK; i++)
+    rc = mvwaddch(win, y, x + i, (unsigned char)str[i]);
+  return rc;
+}
+
+/**
+ * @brief Puts formatted string to window
+ * @param win Window
+ * @param y Y coordinate in window
+ * @param x X coordinate in window
+ * @param fmt Format string
+ *
+ * @return OK, ERR if position is outside of window or screen
+ */
+int mvwprintw(WINDOW *win, int y, int x, char const *fmt, ...) {
+  char line[ANSI_COLS + 1];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  return mvwaddnstr(win, y, x, line, -1);
+}
+
+/**
+ * @brief Turns on attributes of characters drawn to window
+ * @param win Window
+ * @param attrs Attributes
+ *
+ * @return OK, ERR if window is NULL
+ */
+int wattron(WINDOW *win, chtype attrs) {
+  if (win) win->attrs |= attrs;
+  return (win) ? OK : ERR;
+}
+
+/**
+ * @brief Turns off attributes of characters drawn to window
+ * @param win Window
+ * @param attrs Attributes
+ *
+ * @return OK, ERR if window is NULL
+ */
+int wattroff(WINDOW *win, chtype attrs) {
+  if (win) win->attrs &= ~attrs;
+  return (win) ? OK : ERR;
+}
+
+/**
+ * @brief ANSI terminals always have colors
+ *
+ * @return TRUE
+ */
+int has_colors(void) { return TRUE; }
+
+/**
+ * @brief Colors need no setup, kept for ncurses compatibility
+ *
+ * @return OK
+ */
+int start_color(void) { return OK; }
+
+/**
+ * @brief Background -1 is always default, kept for ncurses compatibility
+ *
+ * @return OK
+ */
+int use_default_colors(void) { return OK; }
+
+/**
+ * @brief Sets foreground color of color pair, background stays default
+ * @param pair Color pair number
+ * @param fg Foreground color
+ * @param bg Background color (unused)
+ *
+ * @return OK, ERR if pair is out of range
+ */
+int init_pair(short pair, short fg, short bg) {
+  int rc = ERR;
+  (void)bg;
+  if (pair > 0 && pair < ANSI_PAIRS) {
+    updateScreen()->colors[pair] = fg;
+    rc = OK;
+  }
+  return rc;
+}
+
+/**
+ * @brief Marks window as copied to the screen: windows draw straight into the
+ * screen buffer, nothing to copy
+ * @param win Window
+ *
+ * @return OK, ERR if window is NULL
+ */
+int wnoutrefresh(WINDOW *win) {
+  if (win) win->touched = 0;
+  return (win) ? OK : ERR;
+}
+
+/**
+ * @brief Blanks window. Clearing stdscr also clears the terminal, so the next
+ * doupdate() draws the whole screen over whatever the terminal shows
+ * @param win Window
+ *
+ * @return OK, ERR if window is NULL
+ */
+int wclear(WINDOW *win) {
+  Screen_t *screen = updateScreen();
+  for (int i = 0; win && i < win->maxy && win->begy + i < ANSI_LINES; i++)
+    for (int j = 0; j < win->maxx && win->begx + j < ANSI_COLS; j++)
+      screen->back[win->begy + i][win->begx + j] = ' ';
+  if (win == stdscr) {
+    put_seq("\033[0m\033(B\033[H\033[2J");
+    for (int i = 0; i < ANSI_LINES; i++)
+      for (int j = 0; j < ANSI_COLS; j++) screen->front[i][j] = ' ';
+    screen->attrs = 0;
+    screen->y = 0;
+    screen->x = 0;
+  }
+  if (win) win->touched = 1;
+  return (win) ? OK : ERR;
+}
+
+/**
+ * @brief Sets size of stdscr to new terminal size, clipped by the screen
+ * buffer
+ * @param lines Terminal rows
+ * @param cols Terminal columns
+ *
+ * @return OK
+ */
+int resize_term(int lines, int cols) {
+  screen_win.maxy = (lines < ANSI_LINES) ? lines : ANSI_LINES;
+  screen_win.maxx = (cols < ANSI_COLS) ? cols : ANSI_COLS;
+  return OK;
+}
+
+/**
+ * @brief Appends escape sequences switching terminal to attributes of cell
+ * @param screen Screen
+ * @param out Output position
+ * @param cell Cell
+ *
+ * @return Output position after appended sequences
+ */
+static char *put_attrs(Screen_t *screen, char *out, chtype cell) {
+  chtype pair = cell & COLOR_PAIR(0xFF);
+  chtype acs = cell & A_ALTCHARSET;
+  if (pair != (screen->attrs & COLOR_PAIR(0xFF))) {
+    if (pair)
+      out += sprintf(out, "\033[3%dm", screen->colors[pair >> 8]);
+    else
+      out += sprintf(out, "\033[39m");
+  }
+  if (acs != (screen->attrs & A_ALTCHARSET))
+    out += sprintf(out, (acs) ? "\033(0" : "\033(B");
+  screen->attrs = pair | acs;
+  return out;
+}
+
+/**
+ * @brief Sends changed cells of the screen to the terminal with one write
+ * @details Cursor moves only to the first cell of each run of changed cells,
+ * color and character set are switched only when they change
+ *
+ * @return OK, ERR if write failed
+ */
+int doupdate(void) {
+  Screen_t *screen = updateScreen();
+  char *out = screen->out;
+  for (int i = 0; i < ANSI_LINES; i++)
+    for (int j = 0; j < ANSI_COLS; j++) {
+      chtype cell = screen->back[i][j];
+      if (cell != screen->front[i][j]) {
+        if (screen->y != i || screen->x != j)
+          out += sprintf(out, "\033[%d;%dH", i + 1, j + 1);
+        out = put_attrs(screen, out, cell);
+        *out++ = (char)(cell & 0xFF);
+        screen->front[i][j] = cell;
+        screen->y = i;
+        screen->x = j + 1;
+      }
+    }
+  int rc = OK;
+  size_t len = (size_t)(out - screen->out);
+  for (size_t sent = 0; sent < len && rc == OK;) {
+    ssize_t n = write(STDOUT_FILENO, screen->out + sent, len - sent);
+    if (n > 0)
+      sent += (size_t)n;
+    else
+      rc = ERR;
+  }
+  return rc;
+}
@@ -5,35 +5,233 @@
  * game, including game board display, HUD elements, and various UI banners.
  */
 
+#include <stdio.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 
 #include "../../include/tetris.h"
 
+static void terminal_size(int *lines, int *cols);
+static void print_borders(void);
+
+/**
+ * @brief Keeps static object: layout of screen panels
+ *
+ * @return Pointer to layout
+ */
+Layout_t *updateLayout(void) {
+  static Layout_t layout = {0};
+  return &layout;
+}
+
+/**
+ * @brief Keeps static object: windows of screen panels
+ *
+ * @return Pointer to panels
+ */
+Panels_t *updatePanels(void) {
+  static Panels_t panels = {0};
+  return &panels;
+}
+
+/**
+ * @brief Creates windows of board, stats and next figure panels at the layout
+ * of current terminal size
+ * @details Screen is cleared with refresh() first, then only panels are drawn
+ * into, so getch() on untouched stdscr never flushes the screen by itself.
+ * If the terminal is too small for the layout, only a message is printed and
+ * windows stay NULL: drawing into them does nothing until next resize.
+ *
+ * @return int NO_ERROR on success, ERROR if a window cannot be created
+ */
+int init_panels(void) {
+  Panels_t *panels = updatePanels();
+  Layout_t *layout = updateLayout();
+  int lines = 0, cols = 0;
+  int error = NO_ERROR;
+  terminal_size(&lines, &cols);
+  compute_layout(layout, lines, cols, getmaxy(stdscr), getmaxx(stdscr));
+  if (!layout->fits)
+    mvwprintw(stdscr, 0, 0, "Terminal %dx%d is too small, need %dx%d", cols,
+              lines, LAYOUT_W, LAYOUT_H);
+  refresh();
+  if (layout->fits) {
+    panels->board =
+        newwin(BOARD_WIN_H, BOARD_WIN_W, layout->board_y, layout->board_x);
+    panels->stats =
+        newwin(STATS_WIN_H, PANEL_W, layout->board_y, layout->panel_x);
+    panels->next = newwin(NEXT_WIN_H, PANEL_W, layout->next_y, layout->panel_x);
+    panels->perf =
+        newwin(PERF_WIN_H, PERF_WIN_W, layout->perf_y, layout->board_x);
+    if (!panels->board || !panels->stats || !panels->next || !panels->perf)
+      error = ERROR;
+  }
+  return error;
+}
+
+/**
+ * @brief Adopts new terminal size: screen is cleared, windows are created
+ * again at the new layout. Done only on resize, frames between resizes draw
+ * only what changed
+ */
+void resize_panels(void) {
+  int lines = 0, cols = 0;
+  terminal_size(&lines, &cols);
+  if (lines > 0 && cols > 0) resize_term(lines, cols);
+  free_panels();
+  clear();
+  init_panels();
+}
+
+/**
+ * @brief Reads terminal size
+ * @param lines Terminal rows, 0 if size is unknown
+ * @param cols Terminal columns, 0 if size is unknown
+ */
+static void terminal_size(int *lines, int *cols) {
+  struct winsize ws = {0};
+  int known = ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 &&
+              ws.ws_col > 0;
+  *lines = (known) ? ws.ws_row : 0;
+  *cols = (known) ? ws.ws_col : 0;
+}
+
+/**
+ * @brief Deletes windows of screen panels
+ */
+void free_panels(void) {
+  Panels_t *panels = updatePanels();
+  if (panels->board) delwin(panels->board);
+  if (panels->stats) delwin(panels->stats);
+  if (panels->next) delwin(panels->next);
+  if (panels->perf) delwin(panels->perf);
+  *panels = (Panels_t){0};
+}
+
+/**
+ * @brief Sends changes of all panels to the terminal as one frame
+ * @details Touched panels are copied to the virtual screen with wnoutrefresh
+ * and the terminal is updated with one doupdate. Frame is sent not earlier
+ * than 1000 / FRAME_RATE_CAP ms after previous one: an earlier frame is not
+ * waited for here but deferred to the event loop, which wakes up for it
+ * unless input comes first.
+ */
+void print_frame(void) {
+  Panels_t *panels = updatePanels();
+  static int64_t last_frame = 0;
+  int64_t due = 0;
+#if FRAME_RATE_CAP > 0
+  due = last_frame + 1000 / FRAME_RATE_CAP;
+#endif
+  if (is_wintouched(panels->board) || is_wintouched(panels->stats) ||
+      is_wintouched(panels->next) || is_wintouched(panels->perf)) {
+    if (due > monotonic_ms()) {
+      events_defer_frame(due);
+    } else {
+      wnoutrefresh(panels->board);
+      wnoutrefresh(panels->stats);
+      wnoutrefresh(panels->next);
+      wnoutrefresh(panels->perf);
+      doupdate();
+      last_frame = monotonic_ms();
+      events_defer_frame(0);
+    }
+  }
+}
+
 /**
  * @brief Draws a rectangular frame using ncurses ACS characters
+ * @param win Window to draw in
  * @param top_y Top Y coordinate of the rectangle
  * @param bottom_y Bottom Y coordinate of the rectangle
  * @param left_x Left X coordinate of the rectangle
  * @param right_x Right X coordinate of the rectangle
  * @details Draws a complete rectangle with corners and borders using
  * ACS (Alternative Character Set) symbols for consistent appearance.
- * The function creates a box with proper corners and edges.
+ * The function creates a box with proper corners and edges. Top or bottom
+ * edge outside of the window is skipped: it is drawn by adjacent window.
  */
-static void print_rectangle(int top_y, int bottom_y, int left_x, int right_x) {
-  MVADDCH(top_y, left_x, ACS_ULCORNER); /**< Upper left corner */
-  for (int i = left_x + 1; i < right_x; i++)
-    MVADDCH(top_y, i, ACS_HLINE);        /**< Top horizontal line */
-  MVADDCH(top_y, right_x, ACS_URCORNER); /**< Upper right corner */
+static void print_rectangle(WINDOW *win, int top_y, int bottom_y, int left_x,
+                            int right_x) {
+  if (top_y >= 0) {
+    mvwaddch(win, top_y, left_x, ACS_ULCORNER); /**< Upper left corner */
+    for (int i = left_x + 1; i < right_x; i++)
+      mvwaddch(win, top_y, i, ACS_HLINE); /**< Top horizontal line */
+    mvwaddch(win, top_y, right_x, ACS_URCORNER); /**< Upper right corner */
+  }
 
   for (int i = top_y + 1; i < bottom_y; i++) {
-    MVADDCH(i, left_x, ACS_VLINE);  /**< Left vertical line */
-    MVADDCH(i, right_x, ACS_VLINE); /**< Right vertical line */
+    mvwaddch(win, i, left_x, ACS_VLINE);  /**< Left vertical line */
+    mvwaddch(win, i, right_x, ACS_VLINE); /**< Right vertical line */
   }
 
-  MVADDCH(bottom_y, left_x, ACS_LLCORNER); /**< Lower left corner */
-  for (int i = left_x + 1; i < right_x; i++)
-    MVADDCH(bottom_y, i, ACS_HLINE);        /**< Bottom horizontal line */
-  MVADDCH(bottom_y, right_x, ACS_LRCORNER); /**< Lower right corner */
+  if (bottom_y < getmaxy(win)) {
+    mvwaddch(win, bottom_y, left_x, ACS_LLCORNER); /**< Lower left corner */
+    for (int i = left_x + 1; i < right_x; i++)
+      mvwaddch(win, bottom_y, i, ACS_HLINE); /**< Bottom horizontal line */
+    mvwaddch(win, bottom_y, right_x, ACS_LRCORNER); /**< Lower right corner */
+  }
+}
+
+/**
+ * @brief Initializes color pairs of pieces
+ * @details Color pair PIECE_ID(type) is the color of figure type on default
+ * background. Does nothing on terminals without colors, pieces are drawn
+ * without attributes then.
+ */
+static void init_piece_colors(void) {
+  static short const colors[NUMBER_OF_FIGURES] = PIECE_COLORS;
+  if (has_colors()) {
+    start_color();
+    use_default_colors();
+    for (int type = 0; type < NUMBER_OF_FIGURES; type++)
+      init_pair(PIECE_ID(type), colors[type], -1);
+    init_pair(GARBAGE_CELL, GARBAGE_COLOR, -1);
+  }
+}
+
+/**
+ * @brief Prints a run of same blocks with one ncurses call
+ * @param win Window to print in
+ * @param y Y coordinate of the run
+ * @param x X coordinate of the first block
+ * @param len Number of blocks in the run
+ * @param cell Cell value of all blocks (EMPTY_CELL or piece id)
+ * @details Filled blocks are printed in color pair of the piece. One attribute
+ * switch and one mvaddnstr per run instead of one mvprintw per block.
+ */
+static void print_run(WINDOW *win, int y, int x, int len, cell_t cell) {
+  static char blocks[COLS_MAP * PIXEL_WIDTH + 1] = {0};
+  static char blanks[COLS_MAP * PIXEL_WIDTH + 1] = {0};
+  if (blocks[0] == '\0')
+    for (int j = 0; j < COLS_MAP; j++) {
+      memcpy(blocks + j * PIXEL_WIDTH, PIXEL_1, PIXEL_WIDTH);
+      memcpy(blanks + j * PIXEL_WIDTH, PIXEL_0, PIXEL_WIDTH);
+    }
+  if (CELL_FILLED(cell)) {
+    wattron(win, COLOR_PAIR(cell));
+    mvwaddnstr(win, y, x, blocks, len * PIXEL_WIDTH);
+    wattroff(win, COLOR_PAIR(cell));
+  } else {
+    mvwaddnstr(win, y, x, blanks, len * PIXEL_WIDTH);
+  }
+}
+
+/**
+ * @brief Prints a row of cells grouping consecutive same cells into runs
+ * @param win Window to print in
+ * @param y Y coordinate of the row
+ * @param x X coordinate of the first cell
+ * @param cells Row of cells
+ * @param n Number of cells in the row
+ */
+static void print_cells(WINDOW *win, int y, int x, cell_t const *cells,
+                        int n) {
+  for (int j = 0, k = 0; j < n; j = k) {
+    while (k < n && cells[k] == cells[j]) k++;
+    print_run(win, y, x + j * PIXEL_WIDTH, k - j, cells[j]);
+  }
 }
 
 /**
@@ -43,46 +241,101 @@ static void print_rectangle(int top_y, int bottom_y, int left_x, int right_x) {
  * The function sets up the complete static visual layout of the game.
  */
 void print_overlay(void) {
+  init_piece_colors();
+  print_borders();
+
+  /** Print introductory message centered on the game board */
+  mvwprintw(updatePanels()->board, BOARD_N / 2,
+            (BOARD_M - INTRO_MESSAGE_LEN) / 2 + 1, INTRO_MESSAGE);
+}
+
+/**
+ * @brief Draws all panels of a running game after resize
+ * @details Panels are drawn from the game state: borders and labels, stats,
+ * board with current figure and next figure
+ */
+void print_game_screen(void) {
+  print_borders();
+  print_stats();
+  print_board();
+  clear_and_print_next_figure();
+}
+
+/**
+ * @brief Prints borders of board and status panel with static labels
+ */
+static void print_borders(void) {
+  Panels_t *panels = updatePanels();
+
   /** Draw main game board border */
-  print_rectangle(0, BOARD_N + 1, 0, BOARD_M + 1);
+  print_rectangle(panels->board, 0, BOARD_N + 1, 0, BOARD_M + 1);
 
-  /** Draw status panel border on the right side */
-  print_rectangle(0, BOARD_N + 1, BOARD_M + 2,
-                  BOARD_M + STATUS_PANEL_WIDTH + 5);
+  /** Draw status panel border on the right side, split between stats and
+   * next figure windows */
+  print_rectangle(panels->stats, 0, STATS_WIN_H, 0, PANEL_W - 1);
+  print_rectangle(panels->next, -1, NEXT_WIN_H - 1, 0, PANEL_W - 1);
 
   /** Draw individual boxes within status panel for different statistics */
-  print_rectangle(1, 3, BOARD_M + 3,
-                  BOARD_M + STATUS_PANEL_WIDTH + 4); /**< Current score box */
-  print_rectangle(4, 7, BOARD_M + 3,
-                  BOARD_M + STATUS_PANEL_WIDTH + 4); /**< High score box */
-  print_rectangle(8, 10, BOARD_M + 3,
-                  BOARD_M + STATUS_PANEL_WIDTH + 4); /**< Level box */
+  print_rectangle(panels->stats, 1, 3, 1,
+                  STATUS_PANEL_WIDTH + 2); /**< Current score box */
+  print_rectangle(panels->stats, 4, 7, 1,
+                  STATUS_PANEL_WIDTH + 2); /**< High score box */
+  print_rectangle(panels->stats, 8, 10, 1,
+                  STATUS_PANEL_WIDTH + 2); /**< Level box */
 
   /** Print static labels in the status panel */
-  MVPRINTW(2, BOARD_M + 5, "SCORE");  /**< Score label */
-  MVPRINTW(5, BOARD_M + 5, "HIGH");   /**< High score label (first line) */
-  MVPRINTW(6, BOARD_M + 5, "SCORE");  /**< High score label (second line) */
-  MVPRINTW(9, BOARD_M + 5, "LEVEL");  /**< Level label */
-  MVPRINTW(13, BOARD_M + 4, "NEXT:"); /**< Next figure preview label */
-
-  /** Print introductory message centered on the game board */
-  MVPRINTW(BOARD_N / 2, (BOARD_M - INTRO_MESSAGE_LEN) / 2 + 1, INTRO_MESSAGE);
+  mvwprintw(panels->stats, 2, 3, "SCORE"); /**< Score label */
+  mvwprintw(panels->stats, 5, 3, "HIGH");  /**< High score label (first line) */
+  mvwprintw(panels->stats, 6, 3, "SCORE"); /**< High score label (2nd line) */
+  mvwprintw(panels->stats, 9, 3, "LEVEL"); /**< Level label */
+  mvwprintw(panels->next, 0, 2, "NEXT:");  /**< Next figure preview label */
 }
 
 /**
  * @brief Prints current game statistics in the status panel
  * @details Updates the dynamic values in the status panel including current
- * score, high score, and level information from the game state. This function
- * should be called whenever game statistics change.
+ * score, high score, and level information from the game state. Under the
+ * boxes locked figures and tetrises are shown, in versus mode stack height of
+ * the peer and garbage rows pending for the player instead. Rows cleared and
+ * keys per piece are shown under the next figure. Values are right-aligned to
+ * STATS_VALUE_W columns and a value is redrawn only when its text changes, so
+ * a spawn without change of stats costs nothing. Windows created again on
+ * resize are drawn from scratch.
  */
 void print_stats(void) {
+  static int const pos[STATS_FIELDS][2] = {
+      {2, 9}, {6, 9}, {9, 9}, {11, 3}, {12, 3}, {NEXT_WIN_H - 3, 3},
+      {NEXT_WIN_H - 2, 3}};
+  static char shown[STATS_FIELDS][16] = {{0}};
+  static int shown_generation = 0;
+  char text[STATS_FIELDS][16] = {{0}};
   GameInfo_t *game = updateCurrentState();
-  MVPRINTW(2, BOARD_M + 11, "%d",
-           game->score); /**< Display current score value */
-  MVPRINTW(6, BOARD_M + 11, "%d",
-           game->high_score); /**< Display high score value */
-  MVPRINTW(9, BOARD_M + 11, "%d",
-           game->level); /**< Display current level value */
+  Versus_t *vs = updateVersus();
+  Panels_t *panels = updatePanels();
+  int kpp = (game->pieces > 0) ? game->inputs * 10 / game->pieces : 0;
+  int value[STATS_FIELDS - 1] = {
+      game->score, game->high_score, game->level,
+      (vs->active) ? vs->peer_height : game->pieces,
+      (vs->active) ? vs->pending_garbage : game->clears[3], game->lines};
+  char const *label[STATS_FIELDS] = {
+      "", "", "", (vs->active) ? "PEER " : "PCS  ",
+      (vs->active) ? "GARB " : "TETR ", "LINE ", "KPP  "};
+  if (shown_generation != updateLayout()->generation) {
+    shown_generation = updateLayout()->generation;
+    for (int i = 0; i < STATS_FIELDS; i++) strcpy(shown[i], "\n");
+  }
+  for (int i = 0; i < STATS_FIELDS - 1; i++)
+    snprintf(text[i], sizeof(text[i]), "%s%*d", label[i], STATS_VALUE_W,
+             value[i]);
+  snprintf(text[STATS_FIELDS - 1], sizeof(text[0]), "%s%*d.%d",
+           label[STATS_FIELDS - 1], STATS_VALUE_W - 2, kpp / 10,
+           kpp % 10); /**< Keys per piece */
+  for (int i = 0; i < STATS_FIELDS; i++)
+    if (strcmp(text[i], shown[i])) {
+      mvwprintw((i < STATS_FIELDS - 2) ? panels->stats : panels->next,
+                pos[i][0], pos[i][1], "%s", text[i]);
+      strcpy(shown[i], text[i]);
+    }
 }
 
 /**
@@ -94,15 +347,10 @@ void print_stats(void) {
 void print_board(void) {
   GameInfo_t *game = updateCurrentState();
 
-  /** Iterate through all cells of the game field (20 rows x 10 columns) */
+  /** Print each row of the game field (ROWS_MAP x COLS_MAP) as runs of
+   * blocks of the same piece */
   for (int i = 0; i < ROWS_MAP; i++)
-    for (int j = 0; j < COLS_MAP; j++) {
-      /** Determine block character based on cell content (1 = filled, 0 =
-       * empty) */
-      char *tray = (game->field[i][j] == 1) ? PIXEL_1 : PIXEL_0;
-      /** Print block at calculated screen position with proper spacing */
-      mvprintw(BOARDS_BEGIN + 1 + i, BOARDS_BEGIN + 1 + j * 3, tray);
-    }
+    print_cells(updatePanels()->board, 1 + i, 1, game->field[i], COLS_MAP);
 
   /** Overlay the current active figure on top of the static board */
   print_clear_figure(PIXEL_1);
@@ -114,20 +362,30 @@ void print_board(void) {
  * PIXEL_0)
  * @details Draws the currently active tetromino at its current position.
  * Can be used for both drawing (PIXEL_1) and clearing (PIXEL_0) the figure.
- * This function handles the visual representation of the moving tetromino.
+ * Blocks in hidden buffer rows are skipped. Consecutive blocks of a row are
+ * printed as one run in the color of the figure.
  */
 void print_clear_figure(char *tray) {
   int **figure = updateFigure();
   FigurePos_t *fig_pos = updateFigurePosition();
+  cell_t cell = strcmp(tray, PIXEL_0)
+                    ? PIECE_ID(updateGameContext()->figure_type)
+                    : EMPTY_CELL;
 
-  /** Iterate through the figure matrix (4x4 for standard tetrominoes) */
-  for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++)
-    for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++)
-      /** Only draw active blocks (value = 1) from the figure matrix */
-      if (figure[i][j] == 1)
-        /** Calculate screen position based on figure position and block size */
-        mvprintw(BOARDS_BEGIN + 1 + fig_pos->y + i,
-                 BOARDS_BEGIN + 1 + (fig_pos->x + j) * 3, tray);
+  /** Iterate through the figure matrix rows in visible rows */
+  for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++) {
+    if (fig_pos->y + i < 0) continue;
+    /** Only draw active blocks (value = 1), one run per consecutive blocks */
+    int j = 0;
+    while (j < SIDE_OF_FIGURE_SQUARE) {
+      int k = j;
+      while (k < SIDE_OF_FIGURE_SQUARE && figure[i][k] == 1) k++;
+      if (k > j)
+        print_run(updatePanels()->board, 1 + fig_pos->y + i,
+                  1 + (fig_pos->x + j) * PIXEL_WIDTH, k - j, cell);
+      j = (k > j) ? k : j + 1;
+    }
+  }
 }
 
 /**
@@ -138,15 +396,17 @@ void print_clear_figure(char *tray) {
  */
 void clear_and_print_next_figure(void) {
   GameInfo_t *game = updateCurrentState();
+  cell_t piece = PIECE_ID(updateGameContext()->next_type);
 
   /** Iterate through the next figure matrix (4x4) */
-  for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++)
-    for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++) {
-      /** Determine block character for next figure (1 = filled, 0 = empty) */
-      char *patch = (game->next[i][j] == 1) ? PIXEL_1 : PIXEL_0;
-      /** Print in the next figure preview area at fixed coordinates */
-      mvprintw(17 + i, BOARD_M + 6 + j * 3, patch);
-    }
+  for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++) {
+    cell_t row[SIDE_OF_FIGURE_SQUARE];
+    /** Block of next figure is its piece (1 = filled, 0 = empty) */
+    for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++)
+      row[j] = (game->next[i][j] == 1) ? piece : EMPTY_CELL;
+    /** Print in the next figure preview area at fixed coordinates */
+    print_cells(updatePanels()->next, 2 + i, 2, row, SIDE_OF_FIGURE_SQUARE);
+  }
 }
 
 /**
@@ -156,23 +416,31 @@ void clear_and_print_next_figure(void) {
  * on top of the current game state.
  */
 void print_pause_banner(void) {
-  MVPRINTW(BOARD_N / 2 - 1, 1, "------------------------------");
-  MVPRINTW(BOARD_N / 2, 1, "          GAME PAUSED         ");
-  MVPRINTW(BOARD_N / 2 + 1, 1, "   press any key to continue  ");
-  MVPRINTW(BOARD_N / 2 + 2, 1, "------------------------------");
+  WINDOW *win = updatePanels()->board;
+  mvwprintw(win, BOARD_N / 2 - 1, BANNER_X, "------------------------------");
+  mvwprintw(win, BOARD_N / 2, BANNER_X, "          GAME PAUSED         ");
+  mvwprintw(win, BOARD_N / 2 + 1, BANNER_X, "     press P to continue      ");
+  mvwprintw(win, BOARD_N / 2 + 2, BANNER_X, "------------------------------");
 }
 
 /**
  * @brief Displays the game over banner overlay
  * @details Shows a centered banner when the game ends,
  * with instructions for exiting the game. This indicates
- * that the game has ended normally (board filled up).
+ * that the game has ended normally (board filled up). In versus mode the
+ * banner tells who won.
  */
 void print_gameover_banner(void) {
-  MVPRINTW(BOARD_N / 2 - 1, 1, "------------------------------");
-  MVPRINTW(BOARD_N / 2, 1, "           GAME OVER          ");
-  MVPRINTW(BOARD_N / 2 + 1, 1, "     press any key to quit    ");
-  MVPRINTW(BOARD_N / 2 + 2, 1, "------------------------------");
+  WINDOW *win = updatePanels()->board;
+  Versus_t *vs = updateVersus();
+  char const *title = "           GAME OVER          ";
+  if (vs->active)
+    title = (vs->peer_over) ? "            YOU WIN           "
+                            : "           YOU LOSE           ";
+  mvwprintw(win, BOARD_N / 2 - 1, BANNER_X, "------------------------------");
+  mvwprintw(win, BOARD_N / 2, BANNER_X, "%s", title);
+  mvwprintw(win, BOARD_N / 2 + 1, BANNER_X, "     press any key to quit    ");
+  mvwprintw(win, BOARD_N / 2 + 2, BANNER_X, "------------------------------");
 }
 
 /**
@@ -182,8 +450,40 @@ void print_gameover_banner(void) {
  * errors like file access issues or memory allocation failures.
  */
 void print_exit_error_banner(void) {
-  MVPRINTW(BOARD_N / 2 - 1, 1, "------------------------------");
-  MVPRINTW(BOARD_N / 2, 1, "         ERROR OCCURED        ");
-  MVPRINTW(BOARD_N / 2 + 1, 1, "     press any key to quit    ");
-  MVPRINTW(BOARD_N / 2 + 2, 1, "------------------------------");
+  WINDOW *win = updatePanels()->board;
+  mvwprintw(win, BOARD_N / 2 - 1, BANNER_X, "------------------------------");
+  mvwprintw(win, BOARD_N / 2, BANNER_X, "         ERROR OCCURED        ");
+  mvwprintw(win, BOARD_N / 2 + 1, BANNER_X, "     press any key to quit    ");
+  mvwprintw(win, BOARD_N / 2 + 2, BANNER_X, "------------------------------");
+}
+
+/**
+ * @brief Displays or clears the debug panel
+ * @details Shows p50/p99 of frame time and input latency in microseconds while
+ * the panel is toggled on, blank lines otherwise. A line is redrawn only when
+ * its text changes, so hidden panel costs nothing per frame. Window created
+ * again on resize is drawn from scratch.
+ */
+void print_perf_panel(void) {
+  static char shown[PERF_WIN_H][PERF_WIN_W + 1] = {{0}};
+  static int shown_generation = 0;
+  char line[PERF_WIN_H][PERF_WIN_W + 1] = {{0}};
+  PerfStats_t *perf = updatePerfStats();
+  if (shown_generation != updateLayout()->generation) {
+    shown_generation = updateLayout()->generation;
+    for (int i = 0; i < PERF_WIN_H; i++) strcpy(shown[i], "\n");
+  }
+  if (perf->visible) {
+    snprintf(line[0], sizeof(line[0]), "FRAME  p50 %7lld us  p99 %7lld us",
+             (long long)perf_percentile(&perf->frame, 50),
+             (long long)perf_percentile(&perf->frame, 99));
+    snprintf(line[1], sizeof(line[1]), "INPUT  p50 %7lld us  p99 %7lld us",
+             (long long)perf_percentile(&perf->input, 50),
+             (long long)perf_percentile(&perf->input, 99));
+  }
+  for (int i = 0; i < PERF_WIN_H; i++)
+    if (strcmp(line[i], shown[i])) {
+      mvwprintw(updatePanels()->perf, i, 0, "%-*s", PERF_WIN_W - 1, line[i]);
+      strcpy(shown[i], line[i]);
+    }
 }
@@ -0,0 +1,286 @@
+/**
+ * @file ansi_term.h
+ * @brief Minimal terminal layer of raw ANSI renderer
+ * @details Replaces ncurses when built with USE_ANSI (make RENDERER=ANSI):
+ * provides the subset of ncurses interface used by game logic and the CLI
+ * frontend on top of termios and raw escape sequences. Windows draw into one
+ * screen buffer, doupdate() sends only changed cells, composed into one buffer
+ * and flushed with a single write(2).
+ */
+
+#ifndef ANSI_TERM_H
+#define ANSI_TERM_H
+
+/**
+ * @brief Maximum screen size handled by the renderer, cells outside are
+ * clipped
+ */
+#define ANSI_LINES 64
+#define ANSI_COLS 128
+
+/**
+ * @brief Screen cell: character (bits 0-7), color pair (bits 8-15) and
+ * A_ALTCHARSET flag
+ */
+typedef unsigned int chtype;
+
+/** @brief Attribute of color pair n */
+#define COLOR_PAIR(n) ((chtype)(n) << 8)
+
+/** @brief Attribute of line drawing (DEC special graphics) characters */
+#define A_ALTCHARSET ((chtype)1 << 16)
+
+/** @brief Line drawing characters */
+#define ACS_ULCORNER ('l' | A_ALTCHARSET)
+#define ACS_URCORNER ('k' | A_ALTCHARSET)
+#define ACS_LLCORNER ('m' | A_ALTCHARSET)
+#define ACS_LRCORNER ('j' | A_ALTCHARSET)
+#define ACS_HLINE ('q' | A_ALTCHARSET)
+#define ACS_VLINE ('x' | A_ALTCHARSET)
+
+/**
+ * @brief Window: rectangular region of the screen
+ * @details Windows draw straight into the screen buffer, so they must not
+ * overlap
+ */
+typedef struct {
+  int begy;     /**< Screen Y coordinate of top left corner */
+  int begx;     /**< Screen X coordinate of top left corner */
+  int maxy;     /**< Number of rows */
+  int maxx;     /**< Number of columns */
+  int delay;    /**< Input timeout (ms), -1 - blocking input */
+  chtype attrs; /**< Attributes of drawn characters */
+  int touched;  /**< 1 if window was drawn into since wnoutrefresh() */
+} WINDOW;
+
+extern WINDOW *stdscr;
+
+/** @brief Success return value */
+#define OK 0
+
+/** @brief Error return value, also returned by wgetch on timeout */
+#define ERR (-1)
+
+/** @brief True value for keypad() */
+#define TRUE 1
+
+/** @brief False value for keypad() */
+#define FALSE 0
+
+/**
+ * @brief Colors, same numbers as ANSI SGR 30-37 foregrounds
+ */
+#define COLOR_BLACK 0
+#define COLOR_RED 1
+#define COLOR_GREEN 2
+#define COLOR_YELLOW 3
+#define COLOR_BLUE 4
+#define COLOR_MAGENTA 5
+#define COLOR_CYAN 6
+#define COLOR_WHITE 7
+
+/**
+ * @brief Time (ms) to wait for the rest of an escape sequence after ESC
+ */
+#define ESCDELAY_MS 25
+
+/** @brief Reads one key from stdscr */
+#define getch() wgetch(stdscr)
+
+/** @brief Sets input timeout of stdscr */
+#define timeout(delay) wtimeout(stdscr, delay)
+
+/** @brief Number of rows of window, ERR for NULL window */
+#define getmaxy(win) ((win) ? (win)->maxy : ERR)
+
+/** @brief Number of columns of window, ERR for NULL window */
+#define getmaxx(win) ((win) ? (win)->maxx : ERR)
+
+/** @brief 1 if window was drawn into since wnoutrefresh() */
+#define is_wintouched(win) ((win) && (win)->touched)
+
+/** @brief Blanks stdscr and the terminal */
+#define clear() wclear(stdscr)
+
+/** @brief Sends changes of the screen to the terminal */
+#define refresh() doupdate()
+
+/**
+ * @brief Saves terminal mode, switches to alternate screen with input without
+ * line buffering
+ * @return WINDOW* stdscr covering the whole terminal
+ */
+WINDOW *initscr(void);
+
+/**
+ * @brief Restores terminal mode, cursor and main screen
+ * @return int OK
+ */
+int endwin(void);
+
+/**
+ * @brief Disables echo of typed characters
+ */
+void noecho(void);
+
+/**
+ * @brief Hides (0) or shows (1, 2) cursor
+ * @param visibility Cursor visibility setting
+ * @return int OK
+ */
+int curs_set(int visibility);
+
+/**
+ * @brief Arrow keys are always decoded, kept for ncurses compatibility
+ * @param win Window (unused)
+ * @param enable Keypad enable flag (unused)
+ * @return int OK
+ */
+int keypad(WINDOW *win, int enable);
+
+/**
+ * @brief Sets input timeout of window
+ * @param win Window
+ * @param delay Timeout (ms), negative - blocking input
+ */
+void wtimeout(WINDOW *win, int delay);
+
+/**
+ * @brief Switches between non-blocking and blocking input
+ * @param win Window
+ * @param enable 1 - non-blocking input, 0 - blocking input
+ * @return int OK
+ */
+int nodelay(WINDOW *win, int enable);
+
+/**
+ * @brief Reads one key waiting for input timeout of window
+ * @param win Window
+ * @return int Character, KEY_UP/KEY_DOWN/KEY_LEFT/KEY_RIGHT for arrow keys or
+ * ERR on timeout
+ */
+int wgetch(WINDOW *win);
+
+/**
+ * @brief Creates window for screen region
+ * @param nlines Number of rows
+ * @param ncols Number of columns
+ * @param begy Screen Y coordinate of top left corner
+ * @param begx Screen X coordinate of top left corner
+ * @return WINDOW* New window, NULL if allocation failed
+ */
+WINDOW *newwin(int nlines, int ncols, int begy, int begx);
+
+/**
+ * @brief Deletes window
+ * @param win Window
+ * @return int OK
+ */
+int delwin(WINDOW *win);
+
+/**
+ * @brief Puts character to window
+ * @param win Window
+ * @param y Y coordinate in window
+ * @param x X coordinate in window
+ * @param ch Character with attributes
+ * @return int OK, ERR if window is NULL or position is outside of window
+ */
+int mvwaddch(WINDOW *win, int y, int x, chtype ch);
+
+/**
+ * @brief Puts at most n characters of string to window
+ * @param win Window
+ * @param y Y coordinate in window
+ * @param x X coordinate in window
+ * @param str String
+ * @param n Maximum number of characters, -1 - whole string
+ * @return int OK, ERR if position is outside of window
+ */
+int mvwaddnstr(WINDOW *win, int y, int x, char const *str, int n);
+
+/**
+ * @brief Puts formatted string to window
+ * @param win Window
+ * @param y Y coordinate in window
+ * @param x X coordinate in window
+ * @param fmt Format string
+ * @return int OK, ERR if position is outside of window
+ */
+int mvwprintw(WINDOW *win, int y, int x, char const *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+/**
+ * @brief Turns on attributes of characters drawn to window
+ * @param win Window
+ * @param attrs Attributes
+ * @return int OK, ERR if window is NULL
+ */
+int wattron(WINDOW *win, chtype attrs);
+
+/**
+ * @brief Turns off attributes of characters drawn to window
+ * @param win Window
+ * @param attrs Attributes
+ * @return int OK, ERR if window is NULL
+ */
+int wattroff(WINDOW *win, chtype attrs);
+
+/**
+ * @brief ANSI terminals always have colors
+ * @return int TRUE
+ */
+int has_colors(void);
+
+/**
+ * @brief Colors need no setup, kept for ncurses compatibility
+ * @return int OK
+ */
+int start_color(void);
+
+/**
+ * @brief Background -1 is always default, kept for ncurses compatibility
+ * @return int OK
+ */
+int use_default_colors(void);
+
+/**
+ * @brief Sets foreground color of color pair, background stays default
+ * @param pair Color pair number
+ * @param fg Foreground color
+ * @param bg Background color (unused)
+ * @return int OK, ERR if pair is out of range
+ */
+int init_pair(short pair, short fg, short bg);
+
+/**
+ * @brief Marks window as copied to the screen
+ * @param win Window
+ * @return int OK, ERR if window is NULL
+ */
+int wnoutrefresh(WINDOW *win);
+
+/**
+ * @brief Blanks window, for stdscr also clears the terminal
+ * @param win Window
+ * @return int OK, ERR if window is NULL
+ */
+int wclear(WINDOW *win);
+
+/**
+ * @brief Adopts new terminal size
+ * @param lines Terminal rows
+ * @param cols Terminal columns
+ * @return int OK
+ */
+int resize_term(int lines, int cols);
+
+/**
+ * @brief Sends changed cells of the screen to the terminal with one write
+ * @details Cursor moves only to the first cell of each run of changed cells,
+ * color and character set are switched only when they change
+ * @return int OK, ERR if write failed
+ */
+int doupdate(void);
+
+#endif /* ANSI_TERM_H */
@@ -9,6 +9,10 @@
 #ifndef BACKEND_H
 #define BACKEND_H
 
+#include <stdint.h>
+
+#include "defines.h"
+
 /**
  * @brief Structure representing figure position coordinates
  * @details Stores the current (x,y) position of the active tetromino on the
@@ -19,21 +23,95 @@ typedef struct {
   int y; /**< Y-coordinate position on the game field */
 } FigurePos_t;
 
+/**
+ * @brief Structure containing engine-side state of the game session
+ * @details Keeps data the frontend does not need: which tetromino the current
+ * and next figures are and in which rotation state they are. Rotation states
+ * follow SRS numbering in the rotation direction of the game: 0 - spawn, 1 -
+ * L, 2 - upside down, 3 - R
+ */
+typedef struct {
+  int figure_type;     /**< Index of the current figure in figures table */
+  int figure_rotation; /**< Rotation state of the current figure (0..3) */
+  int next_type;       /**< Index of the next figure in figures table */
+  int next_rotation;   /**< Rotation state of the next figure (0..3) */
+  int lock_active;     /**< Lock delay flag (1 = figure is grounded) */
+  int lock_resets;     /**< Lock delay restarts made on the lowest row */
+  int lowest_y;        /**< Lowest row reached by the current figure */
+  int64_t lock_start;  /**< Monotonic time lock delay (re)started (ms) */
+  int64_t pause_start; /**< Monotonic time game was paused (ms) */
+  int64_t start_ms;    /**< Monotonic time game started, plus pauses (ms) */
+  int gravity;         /**< Rows per tick, in 1/GRAVITY_UNIT of a row */
+  int gravity_acc;     /**< Fraction of a row accumulated by gravity */
+  int tick_ms;         /**< Time since last game tick in netplay (ms) */
+} GameContext_t;
+
 /**
  * @brief Structure containing complete game state information
- * @details Maintains all necessary data for the current game session including
- * field state, next figure preview, scoring, and game settings
+ * @details View of the current game state for the frontend: field and next
+ * figure point into GameState_t cells, other values are copies made by
+ * updateCurrentState()
  */
 typedef struct {
-  int **field;    /**< 2D array representing the game field/grid */
+  cell_t **field; /**< 2D array representing the game field/grid (piece id
+                     per cell), rows -HIDDEN_ROWS..-1 are hidden buffer above
+                     visible rows */
   int **next;     /**< 2D array representing the next upcoming figure */
   int score;      /**< Current player score */
   int high_score; /**< All-time high score */
   int level;      /**< Current game level */
   int speed;      /**< Current game speed (falling rate) */
   int pause;      /**< Pause state flag (0 = running, 1 = paused) */
+  int lines;      /**< Rows cleared */
+  int clears[4];  /**< Clears of 1, 2, 3 and 4 rows */
+  int pieces;     /**< Figures locked */
+  int inputs;     /**< Moves and rotations of the player */
 } GameInfo_t;
 
+/**
+ * @brief Flat state of one game session
+ * @details Contains no pointers, so a game is copied (snapshot, rollback,
+ * search) with a plain assignment or memcpy. Aligned to cache line, field
+ * rows 0..HIDDEN_ROWS-1 are the hidden buffer
+ */
+typedef struct {
+  _Alignas(64) cell_t field[FIELD_ROWS][COLS_MAP]; /**< Field cells */
+  /** Next figure cells */
+  int next[SIDE_OF_FIGURE_SQUARE][SIDE_OF_FIGURE_SQUARE];
+  /** Current figure cells */
+  int figure[SIDE_OF_FIGURE_SQUARE][SIDE_OF_FIGURE_SQUARE];
+  FigurePos_t figure_pos; /**< Current figure position */
+  GameContext_t context;  /**< Figure types, lock delay and gravity */
+  int score;              /**< Current player score */
+  int high_score;         /**< All-time high score */
+  int level;              /**< Current game level */
+  int speed;              /**< Current game speed (falling rate) */
+  int pause;              /**< Pause state flag (0 = running, 1 = paused) */
+  uint32_t seed;          /**< State of figures random generator */
+  uint32_t start_seed;    /**< Seed the game started with */
+  int lines;              /**< Rows cleared */
+  int clears[4];          /**< Clears of 1, 2, 3 and 4 rows */
+  int pieces;             /**< Figures locked */
+  int inputs;             /**< Moves and rotations of the player */
+} GameState_t;
+
+/**
+ * @brief Screen positions of panels, computed once per terminal resize
+ * @details Layout is centered in the part of the terminal the screen buffer
+ * covers. Panels are not created while it is smaller than LAYOUT_H x LAYOUT_W
+ */
+typedef struct {
+  int lines;      /**< Screen rows, 0 - unknown */
+  int cols;       /**< Screen columns, 0 - unknown */
+  int board_y;    /**< Screen Y of board and stats windows */
+  int board_x;    /**< Screen X of board and debug windows */
+  int panel_x;    /**< Screen X of stats and next figure windows */
+  int next_y;     /**< Screen Y of next figure window */
+  int perf_y;     /**< Screen Y of debug window */
+  int fits;       /**< 1 if layout fits the screen */
+  int generation; /**< Number of computed layouts (windows are recreated) */
+} Layout_t;
+
 // ====================
 // State Management Functions
 // ====================
@@ -41,26 +119,46 @@ typedef struct {
 /**
  * @brief Retrieves the current game state information
  * @return Pointer to the current GameInfo_t structure
- * @details Provides access to the global game state containing field data,
- * scores, and game settings. Returns a singleton instance.
+ * @details Refreshes and returns the frontend view of the current game state
+ * containing field data, scores, game settings and counters of cleared rows,
+ * locked figures and actions. Returns a singleton
+ * instance, field and next are NULL while no game is initialized.
  */
 GameInfo_t *updateCurrentState(void);
 
+/**
+ * @brief Retrieves the flat state of the current game
+ * @return Pointer to the current GameState_t structure
+ * @details The state lives in the arena of the current game, arena is
+ * acquired on first call. Game logic reads and changes the game through it
+ */
+GameState_t *updateGameState(void);
+
 /**
  * @brief Retrieves the current active figure data
- * @return Pointer to a 2D array representing the current tetromino
+ * @return Pointer to a 2D array representing the current tetromino, NULL if
+ * memory for the game cannot be allocated
  * @details Returns the figure matrix that is currently active and being
- * manipulated
+ * manipulated. Rows point to figure cells of the current GameState_t
  */
 int **updateFigure(void);
 
 /**
  * @brief Retrieves the current figure position
  * @return Pointer to the current FigurePos_t structure
- * @details Provides access to the (x,y) coordinates of the active tetromino
+ * @details Provides access to the (x,y) coordinates of the active tetromino,
+ * part of the current GameState_t
  */
 FigurePos_t *updateFigurePosition(void);
 
+/**
+ * @brief Retrieves the engine-side context of the game
+ * @return Pointer to the current GameContext_t structure
+ * @details Provides access to the figure types and rotation states of the
+ * current and next figures, part of the current GameState_t
+ */
+GameContext_t *updateGameContext(void);
+
 /**
  * @brief Main game loop function
  * @details Controls the primary game execution flow, handling state
@@ -76,11 +174,18 @@ void game_loop(void);
 /**
  * @brief Initializes the game state and resources
  * @return int Error code (0 = success, non-zero = error)
- * @details Initializes random number generation, ncurses window, locale
- * settings
+ * @details Initializes ncurses window, locale settings, clears the game state
+ * and seeds its figures random generator
  */
 int init_game(void);
 
+/**
+ * @brief Clears the current game state for a new game
+ * @param seed Seed of figures random generator
+ * @details Level 1 with its speed and gravity, empty field, no figures
+ */
+void reset_game_state(uint32_t seed);
+
 /**
  * @brief Frees resourses and exit ncurses
  * @details Frees the game field, initial figures, scores, and other game
@@ -89,18 +194,18 @@ int init_game(void);
 void exit_game();
 
 /**
- * @brief Frees memory allocated for the game field
- * @param field Pointer to the 2D field array to free
- * @details Properly deallocates memory used by the game field matrix
+ * @brief Completely frees all game-related resources
+ * @details Field, next figure and figure share one arena, which is returned
+ * to the arena pool for the next game, so creating games in a loop does not
+ * allocate memory
  */
-void free_field(int **field);
+void free_game(void);
 
 /**
- * @brief Completely frees all game-related resources
- * @details Cleans up all dynamically allocated memory including field, figures,
- * and state data
+ * @brief Frees arenas kept in the arena pool
+ * @details Called once on exit, after the last game is freed
  */
-void free_game(void);
+void free_arena_pool(void);
 
 // ====================
 // Figure Management
@@ -120,7 +225,9 @@ void copy_next_figure_to_figure(void);
 
 /**
  * @brief Initializes the starting position for a new figure
- * @details Places the active figure at the top-center of the game field
+ * @details Places the active figure at the top-center of the game field with
+ * its lowest row on the top visible row. Uses precomputed offsets of the
+ * figure type and rotation state
  */
 void init_figure_position(void);
 
@@ -131,6 +238,15 @@ void init_figure_position(void);
  */
 void rotate_figure(int **figure);
 
+/**
+ * @brief Rotates the current figure trying SRS wall kicks on collision
+ * @return int Rotation status (0 = figure kept its rotation, 1 = rotated)
+ * @details Tests the rotated figure mask at the current position and then at
+ * each kick offset of the figure's kick table for this rotation transition.
+ * The first free position is applied to the figure and its position
+ */
+int rotate_figure_with_kicks(void);
+
 // ====================
 // Game Logic Functions
 // ====================
@@ -143,7 +259,31 @@ void rotate_figure(int **figure);
 int check_collide(void);
 
 /**
- * @brief Attaches the current figure to the game field
+ * @brief Computes how many rows the current figure can fall
+ * @return int Number of free rows under the figure (0 = figure is grounded)
+ * @details Looks only at the lowest figure cell of each column instead of
+ * stepping the figure down with collision checks
+ */
+int drop_distance(void);
+
+/**
+ * @brief Advances gravity by one game tick
+ * @return int Number of whole rows the figure has to fall on this tick
+ * @details Adds current gravity to the accumulated fraction of a row, so
+ * gravity between whole rows per tick is spread over ticks
+ */
+int gravity_rows(void);
+
+/**
+ * @brief Checks if the current figure lies entirely in the hidden buffer
+ * @return int Lock out status (0 = figure reaches visible field, 1 = it does
+ * not)
+ */
+int check_lock_out(void);
+
+/**
+ * @brief Attaches the current figure to the game field, cells get piece id of
+ * the figure
  * @details Permanently places the active figure onto the game grid
  */
 void attach_figure_to_field(void);
@@ -157,17 +297,111 @@ void attach_figure_to_field(void);
 int destruction_of_rows(void);
 
 /**
- * @brief Updates high score from file if current score exceeds it
+ * @brief Inserts garbage rows at the bottom of the game field
+ * @param rows Number of garbage rows
+ * @details Field is pushed up by rows, cells pushed out of the hidden buffer
+ * are lost. Garbage rows are GARBAGE_CELL cells with one empty cell in the
+ * same random column
+ */
+void insert_garbage_rows(int rows);
+
+// ====================
+// Lock Delay
+// ====================
+
+/**
+ * @brief Reads the monotonic clock
+ * @return int64_t Milliseconds since an unspecified fixed point
+ */
+int64_t monotonic_ms(void);
+
+/**
+ * @brief Reads the monotonic clock with full resolution
+ * @return int64_t Nanoseconds since an unspecified fixed point
+ */
+int64_t monotonic_ns(void);
+
+/**
+ * @brief Time played in the current game
+ * @return int64_t Milliseconds since the game started without pauses, 0 if it
+ * has not started
+ */
+int64_t play_time_ms(void);
+
+/**
+ * @brief Reads the clock of lock delay
+ * @return int64_t Time set by set_game_clock(), monotonic_ms() if none is set
+ */
+int64_t game_clock_ms(void);
+
+/**
+ * @brief Sets the clock of lock delay, used by deterministic simulation
+ * @param ms Simulated time (ms), negative - monotonic clock
+ */
+void set_game_clock(int64_t ms);
+
+/**
+ * @brief Resets lock delay state for a newly spawned figure
+ */
+void lock_delay_reset(void);
+
+/**
+ * @brief Updates lock delay state after the figure fell by one row
+ * @details Figure is no longer grounded. Reaching a new lowest row clears the
+ * restarts counter
+ */
+void lock_delay_on_fall(void);
+
+/**
+ * @brief Restarts lock delay after a successful move or rotation
+ * @details Has effect only if figure is grounded and LOCK_MOVE_RESETS restarts
+ * are not used up yet
+ */
+void lock_delay_on_move(void);
+
+/**
+ * @brief Makes the figure lock on the next grounded check (hard drop)
+ */
+void lock_delay_force(void);
+
+/**
+ * @brief Checks lock delay of a grounded figure, starts it if not running
+ * @return int Lock status (0 = figure still can move, 1 = figure must lock)
+ */
+int lock_delay_expired(void);
+
+/**
+ * @brief Time left until grounded figure locks
+ * @return int Milliseconds left, 0 if lock delay is over
+ */
+int lock_delay_remaining(void);
+
+/**
+ * @brief Updates high score from the leaderboard if current score exceeds it
  * @return int Error code (0 = success, non-zero = error)
- * @details Reads high score from file, updates if necessary, and saves back
+ * @details Maps the leaderboard file on first call. The finished game is
+ * written to the leaderboard at game over by leaderboard_record()
  */
 int high_score_update(void);
 
 /**
  * @brief Recalculates game statistics after row destruction
  * @param n_rows Number of rows destroyed in the last operation
- * @details Updates score, level, and speed based on rows cleared
+ * @details Updates score, level, and speed and gravity based on rows cleared.
+ * Speed and gravity of the level are taken from the gravity table
  */
 void recalculate_stats(int n_rows);
 
+/**
+ * @brief Computes screen positions of panels centered on the screen
+ * @param layout Layout to fill
+ * @param lines Terminal rows, 0 - unknown: panels start at BOARDS_BEGIN
+ * @param cols Terminal columns, 0 - unknown
+ * @param max_lines Rows of the screen buffer (stdscr), terminal rows past it
+ * are not drawn; 0 or less - no limit
+ * @param max_cols Columns of the screen buffer (stdscr); 0 or less - no limit
+ */
+void compute_layout(Layout_t *layout, int lines, int cols, int max_lines,
+                    int max_cols);
+
 #endif /* BACKEND_H */
@@ -0,0 +1,99 @@
+/**
+ * @file broadcast.h
+ * @brief Spectator broadcast of board deltas over a Unix domain socket
+ * @details Game started with --broadcast PATH listens on the socket PATH for
+ * any number of spectators. Each frame, cells of the board (field with the
+ * current figure) changed since the previous frame are encoded once as a
+ * delta message and written with one non-blocking write to every spectator.
+ * Spectator gets a key frame of the whole board when it connects. Spectator
+ * that does not take a whole message at once is dropped, so slow consumers
+ * never stall the game.
+ *
+ * Message: 8 byte header - type ('K' key frame, 'D' delta), board columns,
+ * number of cells (16 bits) and frame number (32 bits), little-endian -
+ * followed by 3 bytes per cell: row, column and cell value (EMPTY_CELL, piece
+ * id or GARBAGE_CELL).
+ */
+
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <stdint.h>
+
+#include "defines.h"
+
+/**
+ * @brief Maximum number of spectators, further ones are refused
+ */
+#define BROADCAST_MAX_CLIENTS 256
+
+/**
+ * @brief Size of message header (bytes)
+ */
+#define BROADCAST_HEADER_SIZE 8
+
+/**
+ * @brief Size of one cell in message (bytes)
+ */
+#define BROADCAST_CELL_SIZE 3
+
+/**
+ * @brief Size of the largest message: every cell of the board
+ */
+#define BROADCAST_MSG_MAX \
+  (BROADCAST_HEADER_SIZE + BROADCAST_CELL_SIZE * ROWS_MAP * COLS_MAP)
+
+/**
+ * @brief Command line option of broadcast mode, followed by socket path
+ */
+#define BROADCAST_OPTION "--broadcast"
+
+/**
+ * @brief State of spectator broadcast
+ */
+typedef struct {
+  int active;                         /**< 1 if broadcast is on */
+  int listen_fd;                      /**< Socket accepting spectators */
+  char path[108];                     /**< Socket path, unlinked on free */
+  int clients[BROADCAST_MAX_CLIENTS]; /**< Sockets of spectators */
+  int n_clients;                      /**< Number of spectators */
+  cell_t shown[ROWS_MAP][COLS_MAP];   /**< Board as of the last frame sent */
+  uint32_t frame;                     /**< Number of delta frames sent */
+  int dropped;                        /**< Spectators dropped as too slow */
+} Broadcast_t;
+
+/**
+ * @brief Retrieves state of spectator broadcast
+ * @return Broadcast_t* Pointer to broadcast singleton
+ */
+Broadcast_t *updateBroadcast(void);
+
+/**
+ * @brief Listens for spectators on path, the socket is watched by the event
+ * loop
+ * @param path Socket path
+ * @return int NO_ERROR on success, ERROR if socket cannot be created
+ */
+int broadcast_init(char const *path);
+
+/**
+ * @brief Sends the last frame, closes sockets and removes socket path
+ */
+void broadcast_free(void);
+
+/**
+ * @brief Handler of listening socket for the event loop: accepts spectators
+ * and sends them key frame
+ * @param fd Readable listening socket
+ * @return int INPUT_NONE
+ */
+int broadcast_on_ready(int fd);
+
+/**
+ * @brief Sends cells of the board changed since previous frame to all
+ * spectators
+ * @details Does nothing without spectators or changes
+ */
+void broadcast_frame(void);
+
+#endif /* BROADCAST_H */
@@ -8,6 +8,8 @@
 #ifndef DEFINES_H
 #define DEFINES_H
 
+#include <stdint.h>
+
 // ====================
 // NCurses Configuration Macros
 // ====================
@@ -40,6 +42,26 @@
  */
 #define MAX_LEVEL 10
 
+/**
+ * @brief Level cap switch
+ * @details 1 - game is over when level exceeds MAX_LEVEL, 0 - game goes on
+ * along the extended gravity curve. Can be overridden with -DLEVEL_CAP=0
+ */
+#ifndef LEVEL_CAP
+#define LEVEL_CAP 1
+#endif
+
+/**
+ * @brief Fixed point unit of gravity: gravity of GRAVITY_UNIT is one row per
+ * game tick
+ */
+#define GRAVITY_UNIT 256
+
+/**
+ * @brief Gravity that drops figure to the stack in a single tick (20G)
+ */
+#define GRAVITY_20G (ROWS_MAP * GRAVITY_UNIT)
+
 /**
  * @brief Initial timeout for figure falling speed (milliseconds)
  */
@@ -52,9 +74,21 @@
 #define SPEED_DECREMENT 30
 
 /**
- * @brief File path for storing high score records
+ * @brief Time a grounded figure may still be moved before it locks
+ * (milliseconds)
+ */
+#define LOCK_DELAY_MS 500
+
+/**
+ * @brief Maximum number of lock delay restarts by moves or rotations
+ * @details Restarts counter is cleared when figure falls below its lowest row
  */
-#define HIGH_SCORE_FILE "./out/record_note.txt"
+#define LOCK_MOVE_RESETS 15
+
+/**
+ * @brief Number of freed game arenas kept for reuse by next games
+ */
+#define ARENA_POOL_SIZE 4
 
 // ====================
 // Keyboard Input Codes
@@ -92,6 +126,29 @@
  */
 #define SIDE_OF_FIGURE_SQUARE 4
 
+/**
+ * @brief Number of rotation states of a figure
+ */
+#define NUMBER_OF_ROTATIONS 4
+
+/**
+ * @brief Number of offsets tested on rotation (SRS: no offset + 4 kicks)
+ */
+#define NUMBER_OF_KICKS 5
+
+/**
+ * @brief Board size profile, chosen per build: -DBOARD_WIDE (20x16),
+ * -DBOARD_TALL (40x10) or standard 20x10 by default
+ * @details Sizes stay compile-time constants, so every loop over the field
+ * has constant bounds
+ */
+#if defined(BOARD_WIDE)
+#define ROWS_MAP 20
+#define COLS_MAP 16
+#elif defined(BOARD_TALL)
+#define ROWS_MAP 40
+#define COLS_MAP 10
+#else
 /**
  * @brief Number of rows in the game field
  */
@@ -101,13 +158,72 @@
  * @brief Number of columns in the game field
  */
 #define COLS_MAP 10
+#endif
+
+/**
+ * @brief Number of hidden buffer rows above the visible field
+ * @details Hidden rows have negative indices in the game field: row -1 is
+ * right above the top visible row 0
+ */
+#define HIDDEN_ROWS 4
+
+/**
+ * @brief Number of rows in the field storage, hidden and visible
+ */
+#define FIELD_ROWS (HIDDEN_ROWS + ROWS_MAP)
+
+_Static_assert(COLS_MAP >= SIDE_OF_FIGURE_SQUARE && COLS_MAP <= 32,
+               "COLS_MAP must fit figure and row mask");
+_Static_assert(ROWS_MAP >= SIDE_OF_FIGURE_SQUARE,
+               "ROWS_MAP must fit figure");
+
+/**
+ * @brief Bit mask of one field row, bit j is column j
+ * @details 16 bits for boards up to 16 columns, widened to 32 bits otherwise
+ */
+#if COLS_MAP <= 16
+typedef uint16_t row_mask_t;
+#else
+typedef uint32_t row_mask_t;
+#endif
+
+/**
+ * @brief Row mask of a finished row
+ */
+#define FULL_ROW_MASK ((row_mask_t)((1ULL << COLS_MAP) - 1))
+
+/**
+ * @brief One field cell: EMPTY_CELL or piece id of the figure attached there
+ */
+typedef uint8_t cell_t;
+
+/**
+ * @brief Value of an empty field cell
+ */
+#define EMPTY_CELL 0
+
+/**
+ * @brief Piece id stored in field cells for figure type (1..NUMBER_OF_FIGURES)
+ */
+#define PIECE_ID(type) ((cell_t)((type) + 1))
+
+/**
+ * @brief Field cell of garbage rows received in versus mode
+ */
+#define GARBAGE_CELL PIECE_ID(NUMBER_OF_FIGURES)
+
+/**
+ * @brief 1 if field cell is filled by any piece, 0 if it is empty
+ */
+#define CELL_FILLED(cell) ((cell) != EMPTY_CELL)
 
 // ====================
 // Display and Rendering Constants
 // ====================
 
 /**
- * @brief Starting offset for game board rendering
+ * @brief Starting offset for game board rendering when terminal size is
+ * unknown, otherwise the layout is centered in the terminal
  */
 #define BOARDS_BEGIN 2
 
@@ -117,7 +233,8 @@
 #define FIGURESTART_X ((COLS_MAP - SIDE_OF_FIGURE_SQUARE) / 2)
 
 /**
- * @brief Initial Y position for spawning figures (top)
+ * @brief Initial Y position for spawning figures: lowest figure row lands on
+ * the top visible row, upper rows stay in the hidden buffer
  */
 #define FIGURESTART_Y 0
 
@@ -131,6 +248,24 @@
  */
 #define PIXEL_0 "   "
 
+/**
+ * @brief Width of one block on the screen (length of PIXEL_1 and PIXEL_0)
+ */
+#define PIXEL_WIDTH 3
+
+/**
+ * @brief ncurses foreground colors of pieces, indexed by figure type (I, O, J,
+ * L, Z, S, T). Color pair PIECE_ID(type) draws the piece
+ */
+#define PIECE_COLORS                                             \
+  {COLOR_CYAN, COLOR_YELLOW, COLOR_BLUE, COLOR_WHITE, COLOR_RED, \
+   COLOR_GREEN, COLOR_MAGENTA}
+
+/**
+ * @brief ncurses foreground color of garbage rows, color pair GARBAGE_CELL
+ */
+#define GARBAGE_COLOR COLOR_WHITE
+
 /**
  * @brief Introductory message displayed at game start
  */
@@ -157,31 +292,96 @@
  */
 #define BOARD_M (COLS_MAP * 3)
 
+/**
+ * @brief Width of the pause, game over and error banners in character columns
+ */
+#define BANNER_WIDTH 30
+
+/**
+ * @brief Banner X position, centered on the board
+ */
+#define BANNER_X ((BOARD_M - BANNER_WIDTH) / 2 + 1)
+
 /**
  * @brief Width of the status panel area
  */
 #define STATUS_PANEL_WIDTH 13
 
 // ====================
-// Positioning Macros
+// Panel Windows Layout
 // ====================
 
 /**
- * @brief Macro for printing text with board offset
- * @param y Y coordinate relative to board start
- * @param x X coordinate relative to board start
- * @param ... Format string and arguments for mvprintw
+ * @brief Board window height: game board with its border
+ */
+#define BOARD_WIN_H (BOARD_N + 2)
+
+/**
+ * @brief Board window width: game board with its border
+ */
+#define BOARD_WIN_W (BOARD_M + 2)
+
+/**
+ * @brief Status panel width
+ * @details Status panel is right to the board, split in two windows: stats on
+ * top, next figure preview below
+ */
+#define PANEL_W (STATUS_PANEL_WIDTH + 4)
+
+/**
+ * @brief Height of stats window (score, high score and level boxes)
+ */
+#define STATS_WIN_H 13
+
+/**
+ * @brief Width of a value in the status panel, right-aligned
+ * @details Fixed width overwrites all digits of the previous value
+ */
+#define STATS_VALUE_W 6
+
+/**
+ * @brief Number of values in the status panel: score, high score, level, two
+ * counters under the boxes and two under the next figure
+ */
+#define STATS_FIELDS 7
+
+/**
+ * @brief Height of next figure window, the rest of the status panel
+ * @details Label, next figure and two counter lines above the bottom border
+ */
+#define NEXT_WIN_H (BOARD_WIN_H - STATS_WIN_H)
+
+_Static_assert(NEXT_WIN_H >= SIDE_OF_FIGURE_SQUARE + 5,
+               "ROWS_MAP must fit next figure panel");
+
+/**
+ * @brief Debug panel height: frame time and input latency lines
+ */
+#define PERF_WIN_H 2
+
+/**
+ * @brief Debug panel width: under the board and status panel
+ */
+#define PERF_WIN_W (BOARD_WIN_W + PANEL_W)
+
+/**
+ * @brief Height of the whole layout: board and debug panel under it
+ */
+#define LAYOUT_H (BOARD_WIN_H + PERF_WIN_H)
+
+/**
+ * @brief Width of the whole layout: board and status panel
  */
-#define MVPRINTW(y, x, ...) \
-  mvprintw(BOARDS_BEGIN + (y), BOARDS_BEGIN + (x), __VA_ARGS__)
+#define LAYOUT_W (BOARD_WIN_W + PANEL_W)
 
 /**
- * @brief Macro for adding characters with board offset
- * @param y Y coordinate relative to board start
- * @param x X coordinate relative to board start
- * @param c Character to display
+ * @brief Frame rate cap (frames per second) of terminal updates
+ * @details At most one doupdate per 1000 / FRAME_RATE_CAP ms. Can be
+ * overridden with -DFRAME_RATE_CAP=N, 0 - no cap
  */
-#define MVADDCH(y, x, c) mvaddch(BOARDS_BEGIN + (y), BOARDS_BEGIN + (x), c)
+#ifndef FRAME_RATE_CAP
+#define FRAME_RATE_CAP 60
+#endif
 
 // ====================
 // Error Code Constants
@@ -0,0 +1,151 @@
+/**
+ * @file events.h
+ * @brief Event loop of the game: input, game timer and signals
+ * @details Game loop sleeps in one poll(2) on stdin, a timerfd armed with the
+ * game tick (gravity or lock delay) and a signalfd for SIGWINCH, SIGTERM and
+ * SIGINT, and dispatches whichever is ready into the state machine. Further
+ * descriptors (sockets) can be watched with events_watch(). Without timerfd
+ * and signalfd (non-Linux systems) the tick is the poll timeout and signals
+ * are delivered through a self-pipe.
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Maximum number of watched descriptors, including stdin, timer and
+ * signals
+ */
+#define EVENT_MAX_FDS 8
+
+/**
+ * @brief Input signals of events_read_input() besides keys
+ * @details INPUT_TICK is ERR, the value getch() returned on timeout
+ */
+#define INPUT_TICK (-1)      /**< Game timer expired */
+#define INPUT_TERMINATE (-2) /**< SIGTERM/SIGINT or stdin closed */
+#define INPUT_NONE (-3)      /**< Woken up with nothing for state machine */
+#define INPUT_RESIZE (-4)    /**< SIGWINCH, screen must be laid out again */
+#define INPUT_FRAME (-5)     /**< Deferred frame is due, print_frame() */
+
+/**
+ * @brief Events of event loop
+ */
+typedef enum {
+  EVENT_NONE = 0,  /**< Interrupted by signal handler (SIGUSR1/SIGUSR2) */
+  EVENT_INPUT,     /**< Stdin is readable */
+  EVENT_TIMER,     /**< Game timer expired */
+  EVENT_RESIZE,    /**< SIGWINCH */
+  EVENT_TERMINATE, /**< SIGTERM/SIGINT or stdin closed */
+  EVENT_FD,        /**< Descriptor added by events_watch() is readable */
+  EVENT_FRAME      /**< Deferred frame is due */
+} EventType_t;
+
+/**
+ * @brief Event returned by events_wait()
+ */
+typedef struct {
+  EventType_t type; /**< Event */
+  int fd;           /**< Readable descriptor of EVENT_FD */
+} Event_t;
+
+/**
+ * @brief Handler of watched descriptor, called by events_read_input() when
+ * the descriptor is readable
+ * @param fd Readable descriptor
+ * @return int Input for the state machine: key or INPUT_NONE
+ */
+typedef int (*EventHandler_t)(int fd);
+
+/**
+ * @brief Watched descriptors and timer of event loop
+ */
+typedef struct {
+  struct pollfd fds[EVENT_MAX_FDS]; /**< stdin, timer, signals, watched fds */
+  /** Handlers of watched descriptors, NULL for stdin, timer and signals */
+  EventHandler_t handlers[EVENT_MAX_FDS];
+  int nfds;          /**< Number of descriptors, 0 - loop is not created */
+  int timer_ms;      /**< Game tick (ms), negative - timer is disarmed */
+  int64_t deadline;  /**< Next tick, monotonic ms (poll timeout timer) */
+  int signal_pipe;   /**< Write end of self-pipe, -1 with signalfd */
+  int input_pending; /**< 1 if last read key may be followed by buffered ones */
+  int64_t frame_at;  /**< Deferred frame is due, monotonic ms, 0 - none */
+} EventLoop_t;
+
+/**
+ * @brief Retrieves event loop
+ * @return EventLoop_t* Pointer to event loop singleton
+ */
+EventLoop_t *updateEventLoop(void);
+
+/**
+ * @brief Creates timer and signal descriptors, blocks SIGWINCH, SIGTERM and
+ * SIGINT so they are only delivered through the loop
+ * @return int NO_ERROR on success, ERROR if descriptors cannot be created
+ */
+int events_init(void);
+
+/**
+ * @brief Closes timer and signal descriptors, unblocks signals
+ */
+void events_free(void);
+
+/**
+ * @brief Arms periodic game timer, replaces timeout() of the game tick
+ * @param ms Period (ms), negative - disarm
+ */
+void events_set_timer(int ms);
+
+/**
+ * @brief Wakes the loop for a frame deferred by the frame rate cap
+ * @param at Monotonic ms the frame is due, 0 - no deferred frame
+ * @details Replaces sleeping in the renderer: input that comes before the
+ * frame is due is read at once
+ */
+void events_defer_frame(int64_t at);
+
+/**
+ * @brief Adds descriptor to watched ones
+ * @param fd Descriptor
+ * @param handler Called by events_read_input() when fd is readable, NULL -
+ * fd is only reported by events_wait()
+ * @return int NO_ERROR on success, ERROR if EVENT_MAX_FDS are watched
+ */
+int events_watch(int fd, EventHandler_t handler);
+
+/**
+ * @brief Removes descriptor from watched ones
+ * @param fd Descriptor
+ */
+void events_unwatch(int fd);
+
+/**
+ * @brief Sleeps until next event
+ * @return Event_t Ready event: signals first, then timer, input, watched
+ * descriptors and deferred frame
+ */
+Event_t events_wait(void);
+
+/**
+ * @brief Waits for next event and turns it into input of the state machine
+ * @details Readable watched descriptors are passed to their handlers, the
+ * handler result is returned
+ * @param ticks true - timer events are returned as INPUT_TICK, false - timer
+ * is ignored
+ * @return int Key, INPUT_TICK, INPUT_TERMINATE, INPUT_RESIZE, INPUT_FRAME or
+ * INPUT_NONE
+ */
+int events_read_input(bool ticks);
+
+/**
+ * @brief Waits for a key, timer, resize and other events are ignored,
+ * deferred frame is sent
+ * @return int Key or INPUT_TERMINATE
+ */
+int events_wait_key(void);
+
+#endif /* EVENTS_H */
@@ -8,6 +8,60 @@
 #ifndef FRONTEND_H
 #define FRONTEND_H
 
+/**
+ * @brief Windows of screen panels
+ * @details Each panel is drawn into its own window and copied to the screen
+ * with wnoutrefresh, screen is updated once per frame by print_frame()
+ */
+typedef struct {
+  WINDOW *board; /**< Game board with border and banners */
+  WINDOW *stats; /**< Score, high score and level boxes */
+  WINDOW *next;  /**< Next figure preview */
+  WINDOW *perf;  /**< Debug panel: frame time and input latency */
+} Panels_t;
+
+/**
+ * @brief Retrieves layout of screen panels
+ * @return Layout_t* Pointer to layout singleton
+ */
+Layout_t *updateLayout(void);
+
+/**
+ * @brief Retrieves windows of screen panels
+ * @return Panels_t* Pointer to panels, windows are NULL until init_panels()
+ */
+Panels_t *updatePanels(void);
+
+/**
+ * @brief Computes layout for current terminal size and creates windows of
+ * screen panels there
+ * @details If the terminal is too small, windows are not created (drawing
+ * into them does nothing) and a message is shown instead
+ * @return int NO_ERROR on success, ERROR if a window cannot be created
+ */
+int init_panels(void);
+
+/**
+ * @brief Adopts new terminal size: clears the screen and recreates windows of
+ * screen panels at the new layout, their contents must be drawn again
+ */
+void resize_panels(void);
+
+/**
+ * @brief Deletes windows of screen panels
+ */
+void free_panels(void);
+
+/**
+ * @brief Sends changes of all panels to the terminal as one frame
+ * @details Copies touched panels with wnoutrefresh and calls doupdate once.
+ * Frames are paced by FRAME_RATE_CAP: if previous frame was sent less than a
+ * frame interval ago, the frame is deferred with events_defer_frame() and sent
+ * when the event loop wakes up for it. Does nothing if no panel was changed
+ * since previous frame.
+ */
+void print_frame(void);
+
 /**
  * @brief Prints the initial game overlay with borders and static UI elements
  * @details Creates the main game interface including game board border,
@@ -15,6 +69,13 @@
  */
 void print_overlay(void);
 
+/**
+ * @brief Draws all panels of a running game: borders, labels, stats, board
+ * with current figure and next figure
+ * @details Used to restore the screen after resize
+ */
+void print_game_screen(void);
+
 /**
  * @brief Displays the next upcoming tetromino in the preview area
  * @details Renders the next figure in the designated preview area,
@@ -39,7 +100,7 @@ void print_pause_banner(void);
 /**
  * @brief Displays the game over banner overlay
  * @details Shows a centered banner when the game ends normally,
- * with instructions for exiting the game.
+ * with instructions for exiting the game. In versus mode tells who won.
  */
 void print_gameover_banner(void);
 
@@ -53,7 +114,9 @@ void print_exit_error_banner(void);
 /**
  * @brief Updates and displays current game statistics
  * @details Refreshes the dynamic values in the status panel including
- * current score, high score, and level information.
+ * current score, high score, and level information, and versus mode peer
+ * stack height and pending garbage. Only values changed since they were last
+ * drawn are printed, right-aligned to STATS_VALUE_W columns.
  */
 void print_stats(void);
 
@@ -66,4 +129,12 @@ void print_stats(void);
  */
 void print_clear_figure(char *tray);
 
+/**
+ * @brief Displays or clears the debug panel
+ * @details Shows p50/p99 of frame time and input latency while the panel is
+ * toggled on, clears it after it is toggled off. Lines are redrawn only when
+ * their text changes.
+ */
+void print_perf_panel(void);
+
 #endif /* FRONTEND_H */
@@ -21,10 +21,16 @@ typedef enum {
   MOVING,    /**< Active state where tetromino is moving down */
   SHIFTING,  /**< Processing lateral movement or rotation */
   ATTACHING, /**< Finalizing tetromino placement on the field */
+  PAUSED,    /**< Game is paused, game timer is stopped */
   GAMEOVER,  /**< Game has ended normally */
   EXIT_ERROR /**< Game terminated due to an error condition */
 } TetrisState_t;
 
+/**
+ * @brief Number of game states, EXIT_ERROR is the last one
+ */
+#define NUMBER_OF_STATES (EXIT_ERROR + 1)
+
 /**
  * @brief Enumeration of all possible user input actions
  * @details Maps physical user inputs to logical game actions
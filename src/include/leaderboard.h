@@ -0,0 +1,147 @@
+/**
+ * @file leaderboard.h
+ * @brief Leaderboard of top scores in a memory-mapped binary file
+ * @details Leaderboard file keeps LEADERBOARD_SIZE best games as fixed size
+ * records sorted by score, host byte order. The file is memory-mapped, so the
+ * high score and the rank of a score are read with a binary search, without
+ * parsing. The file holds two tables: an update writes the new table into the
+ * inactive one, msync()s it and then switches the generation word in the
+ * header, so a crash leaves either the old or the new table. Updates of
+ * instances running at once are serialized by an advisory lock (fcntl) held
+ * only while the table is written at game over. A missing file is created as
+ * a temporary file linked into place, never replacing a file created by
+ * another instance.
+ */
+
+#ifndef LEADERBOARD_H
+#define LEADERBOARD_H
+
+#include <stdint.h>
+
+/**
+ * @brief Default file path of the leaderboard
+ */
+#define LEADERBOARD_FILE "./out/leaderboard.bin"
+
+/**
+ * @brief Number of games kept in the leaderboard
+ */
+#define LEADERBOARD_SIZE 64
+
+/**
+ * @brief Size of player name with terminating NUL (bytes)
+ */
+#define LEADERBOARD_NAME_SIZE 16
+
+/**
+ * @brief Player name used when USER is not set
+ */
+#define LEADERBOARD_DEFAULT_NAME "player"
+
+/**
+ * @brief First word of the leaderboard file: "TLB1"
+ */
+#define LEADERBOARD_MAGIC 0x31424c54u
+
+/**
+ * @brief Version of the leaderboard file format
+ */
+#define LEADERBOARD_VERSION 1
+
+/**
+ * @brief Record of one finished game
+ */
+typedef struct {
+  char name[LEADERBOARD_NAME_SIZE]; /**< Player name, NUL terminated */
+  int32_t score;                    /**< Final score */
+  int32_t level;                    /**< Final level */
+  int32_t lines;                    /**< Rows cleared */
+  int32_t duration_s;               /**< Time played without pauses (s) */
+  uint32_t seed;                    /**< Seed the game started with */
+} LeaderboardEntry_t;
+
+_Static_assert(sizeof(LeaderboardEntry_t) == 36,
+               "Leaderboard record must have no padding");
+
+/**
+ * @brief Games sorted by score, equal scores in order of insertion
+ */
+typedef struct {
+  uint32_t count;                               /**< Number of games */
+  LeaderboardEntry_t entries[LEADERBOARD_SIZE]; /**< Games */
+} LeaderboardTable_t;
+
+/**
+ * @brief Layout of the leaderboard file
+ */
+typedef struct {
+  uint32_t magic;               /**< LEADERBOARD_MAGIC */
+  uint32_t version;             /**< LEADERBOARD_VERSION */
+  uint32_t capacity;            /**< LEADERBOARD_SIZE */
+  uint32_t generation;          /**< Number of updates, selects the table */
+  LeaderboardTable_t tables[2]; /**< Current table is [generation % 2] */
+} LeaderboardFile_t;
+
+/**
+ * @brief State of the leaderboard
+ */
+typedef struct {
+  int fd;                  /**< Leaderboard file, -1 if not open */
+  LeaderboardFile_t *file; /**< Mapped file, NULL if not open */
+  char const *path;        /**< File opened on demand, LEADERBOARD_FILE */
+} Leaderboard_t;
+
+/**
+ * @brief Retrieves state of the leaderboard
+ * @return Leaderboard_t* Pointer to leaderboard singleton
+ */
+Leaderboard_t *updateLeaderboard(void);
+
+/**
+ * @brief Maps the leaderboard file, creates an empty one if it is missing
+ * @param path File path
+ * @return int NO_ERROR on success, ERROR if the file cannot be created or is
+ * not a leaderboard
+ */
+int leaderboard_open(char const *path);
+
+/**
+ * @brief Unmaps and closes the leaderboard file
+ */
+void leaderboard_close(void);
+
+/**
+ * @brief Current table of the leaderboard
+ * @return LeaderboardTable_t const* Games, NULL if the leaderboard is not open
+ */
+LeaderboardTable_t const *leaderboard_table(void);
+
+/**
+ * @brief Rank a score would take, found with a binary search
+ * @param score Score
+ * @return int Number of games with the same or higher score
+ */
+int leaderboard_rank(int score);
+
+/**
+ * @brief Best score of the leaderboard
+ * @return int Score of the first game, 0 if there is none
+ */
+int leaderboard_top_score(void);
+
+/**
+ * @brief Inserts a game and syncs the file under exclusive lock of the file
+ * @param entry Game
+ * @return int Rank of the game, -1 if it is not in the top LEADERBOARD_SIZE,
+ * scores 0 or the file cannot be synced
+ */
+int leaderboard_insert(LeaderboardEntry_t const *entry);
+
+/**
+ * @brief Inserts the finished current game into the leaderboard, opens the
+ * file at path of leaderboard state if it is not open
+ * @return int Rank of the game, -1 if it is not recorded
+ */
+int leaderboard_record(void);
+
+#endif /* LEADERBOARD_H */
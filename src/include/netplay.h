@@ -0,0 +1,139 @@
+/**
+ * @file netplay.h
+ * @brief Lockstep deterministic netplay with input delay and rollback
+ * @details Two games started with --netplay PATH connect over the versus
+ * socket. Each process simulates both games in fixed NETPLAY_FRAME_MS frames
+ * from inputs only: gravity and lock delay count simulated time, garbage goes
+ * between the simulated games, so both processes compute the same games. The
+ * listening side picks the seed of both games. Local input is scheduled
+ * NETPLAY_INPUT_DELAY frames ahead and sent to the peer. Missing peer input is
+ * predicted as no input; when it arrives and differs, both games are restored
+ * from the snapshot of that frame (plain copy of flat game states) and
+ * simulated again up to the current frame. Simulation waits for the peer
+ * rather than predict more than NETPLAY_MAX_ROLLBACK frames.
+ */
+
+#ifndef NETPLAY_H
+#define NETPLAY_H
+
+#include <stdint.h>
+
+#include "backend.h"
+#include "versus.h"
+
+/**
+ * @brief Length of simulation frame (milliseconds)
+ */
+#define NETPLAY_FRAME_MS 16
+
+/**
+ * @brief Frames local input is scheduled ahead, hides peer latency up to
+ * NETPLAY_INPUT_DELAY * NETPLAY_FRAME_MS ms. Can be overridden with
+ * -DNETPLAY_INPUT_DELAY=N
+ */
+#ifndef NETPLAY_INPUT_DELAY
+#define NETPLAY_INPUT_DELAY 3
+#endif
+
+/**
+ * @brief Maximum number of frames simulated with predicted peer input
+ */
+#define NETPLAY_MAX_ROLLBACK 32
+
+/**
+ * @brief Frames of inputs and snapshots kept, power of two
+ */
+#define NETPLAY_HISTORY 64
+
+_Static_assert(NETPLAY_MAX_ROLLBACK + 2 * NETPLAY_INPUT_DELAY < NETPLAY_HISTORY,
+               "NETPLAY_HISTORY must hold inputs of the rollback window");
+
+/**
+ * @brief Number of local actions queued between frames
+ */
+#define NETPLAY_QUEUE 8
+
+/**
+ * @brief Command line option of netplay mode, followed by socket path
+ */
+#define NETPLAY_OPTION "--netplay"
+
+/**
+ * @brief Everything simulated: both games and garbage between them
+ * @details Contains no pointers, snapshot and restore are plain copies
+ */
+typedef struct {
+  GameState_t games[2]; /**< Games of player 0 (listening side) and 1 */
+  int pending[2];       /**< Garbage rows pending for each player */
+  int over[2];          /**< 1 if game of the player is over */
+} NetplaySim_t;
+
+/**
+ * @brief State of netplay
+ */
+typedef struct {
+  NetplaySim_t sim; /**< Games at the start of frame */
+  /** Games at the start of frame f, [f % NETPLAY_HISTORY] */
+  NetplaySim_t snapshots[NETPLAY_HISTORY];
+  uint8_t local_inputs[NETPLAY_HISTORY];  /**< Local input of frame */
+  uint8_t remote_inputs[NETPLAY_HISTORY]; /**< Received peer input */
+  int remote_frames[NETPLAY_HISTORY];     /**< Frame of received input */
+  uint8_t used_inputs[NETPLAY_HISTORY];   /**< Peer input simulated */
+
+  int enabled;         /**< 1 if netplay mode is on */
+  int started;         /**< 1 after seed is known */
+  int local;           /**< Index of local player */
+  int frame;           /**< Next frame to simulate */
+  int confirmed;       /**< Last frame with peer input received */
+  int rollback_to;     /**< Oldest mispredicted frame, -1 if none */
+  int rollbacks;       /**< Number of rollbacks */
+  int resimulated;     /**< Frames simulated again by rollbacks */
+  int stalls;          /**< Frames waited for peer input */
+  int64_t rollback_ns; /**< Slowest rollback: restore and resimulation */
+} Netplay_t;
+
+/**
+ * @brief Retrieves state of netplay
+ * @return Netplay_t* Pointer to netplay singleton
+ */
+Netplay_t *updateNetplay(void);
+
+/**
+ * @brief Starts both games from seed
+ * @param np Netplay state
+ * @param seed Seed of both games
+ * @param local Index of local player: 0 - listening side, 1 - connecting one
+ */
+void netplay_start(Netplay_t *np, uint32_t seed, int local);
+
+/**
+ * @brief Simulates next frame with local action, rolls back first if peer
+ * input was mispredicted
+ * @param np Netplay state
+ * @param action Local action
+ * @param msg Input message for the peer, set if frame was simulated
+ * @return int 1 if frame was simulated, 0 if simulation waits for peer input
+ */
+int netplay_tick(Netplay_t *np, UserAction_t action, VersusMsg_t *msg);
+
+/**
+ * @brief Takes input of the peer, marks rollback if it was mispredicted
+ * @param np Netplay state
+ * @param msg VERSUS_MSG_LOCKSTEP message
+ */
+void netplay_remote_input(Netplay_t *np, VersusMsg_t msg);
+
+/**
+ * @brief Result of the match once it cannot be rolled back any more
+ * @param np Netplay state
+ * @return int -1 - match goes on, 0 - local player lost, 1 - local player won
+ */
+int netplay_result(Netplay_t const *np);
+
+/**
+ * @brief Game loop of netplay: waits for peer, simulates frames on timer
+ * ticks, shows local game and match result
+ */
+void netplay_loop(void);
+
+#endif /* NETPLAY_H */
@@ -0,0 +1,186 @@
+/**
+ * @file perf.h
+ * @brief Frame time, input latency and engine counters instrumentation
+ * @details Game loop timestamps input arrival (getch return), state transition
+ * (state machine done with the input) and render completion (frame sent) with
+ * the monotonic clock. Frame time and input latency are kept in rolling
+ * histograms of the last PERF_WINDOW samples, their p50/p99 are shown in the
+ * debug panel toggled by PERF_KEY. State machine counts calls, nanoseconds and
+ * transitions of each state handler, engine functions count their calls; the
+ * counters are dumped as JSON on exit and on SIGUSR1.
+ */
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+
+#include "defines.h"
+#include "fsm.h"
+
+/**
+ * @brief Instrumentation switch
+ * @details 1 - timestamps are taken and debug panel is available, 0 - all
+ * perf functions do nothing. Can be overridden with -DPERF_STATS=0
+ */
+#ifndef PERF_STATS
+#define PERF_STATS 1
+#endif
+
+/**
+ * @brief Key toggling debug panel
+ */
+#define PERF_KEY '`'
+
+/**
+ * @brief Number of latest samples kept in rolling histogram
+ */
+#define PERF_WINDOW 256
+
+/**
+ * @brief Number of histogram buckets: 8 linear buckets per power of two of
+ * microseconds (12.5% precision), up to 2^32 us
+ */
+#define PERF_BUCKETS 240
+
+/**
+ * @brief Default path of counters dump, overridden by PERF_DUMP_ENV
+ */
+#define PERF_DUMP_FILE "./out/stats.json"
+
+/**
+ * @brief Environment variable with path of counters dump
+ */
+#define PERF_DUMP_ENV "TETRIS_STATS"
+
+/**
+ * @brief Engine functions with call counters
+ */
+typedef enum {
+  PERF_ASSIGN_NEXT_FIGURE = 0,
+  PERF_COPY_NEXT_FIGURE,
+  PERF_HIGH_SCORE_UPDATE,
+  PERF_INIT_FIGURE_POSITION,
+  PERF_CHECK_COLLIDE,
+  PERF_DROP_DISTANCE,
+  PERF_GRAVITY_ROWS,
+  PERF_ROTATE_WITH_KICKS,
+  PERF_CHECK_LOCK_OUT,
+  PERF_ATTACH_FIGURE,
+  PERF_DESTRUCTION_OF_ROWS,
+  PERF_RECALCULATE_STATS,
+  PERF_FUNCS /**< Number of counted functions */
+} PerfFunc_t;
+
+/**
+ * @brief Rolling histogram of latest PERF_WINDOW samples
+ */
+typedef struct {
+  uint16_t count[PERF_BUCKETS]; /**< Samples per bucket */
+  uint8_t ring[PERF_WINDOW];    /**< Buckets of latest samples */
+  int head;                     /**< Ring position of next sample */
+  int n;                        /**< Number of samples in ring */
+} PerfHistogram_t;
+
+/**
+ * @brief Timestamps of current loop cycle and histograms
+ */
+typedef struct {
+  PerfHistogram_t frame; /**< Frame time: cycle start to render completion */
+  PerfHistogram_t input; /**< Input latency: input arrival to transition */
+  int64_t cycle_start;   /**< Cycle start (getch return), ns, 0 - none */
+  int64_t transition;    /**< State transition done, ns */
+  int has_input;         /**< 1 if cycle was started by a key */
+  int visible;           /**< 1 if debug panel is shown */
+  uint64_t state_calls[NUMBER_OF_STATES]; /**< Calls of state handlers */
+  int64_t state_ns[NUMBER_OF_STATES];     /**< Time in state handlers, ns */
+  /** Transitions [from][to] made by state handlers */
+  uint64_t transitions[NUMBER_OF_STATES][NUMBER_OF_STATES];
+  uint64_t func_calls[PERF_FUNCS]; /**< Calls of engine functions */
+} PerfStats_t;
+
+/**
+ * @brief Retrieves instrumentation state
+ * @return PerfStats_t* Pointer to instrumentation singleton
+ */
+PerfStats_t *updatePerfStats(void);
+
+/**
+ * @brief Adds sample to rolling histogram, evicting the oldest one when the
+ * window is full
+ * @param hist Histogram
+ * @param us Sample (microseconds)
+ */
+void perf_histogram_add(PerfHistogram_t *hist, int64_t us);
+
+/**
+ * @brief Percentile of rolling histogram
+ * @param hist Histogram
+ * @param percent Percentile (1..100)
+ * @return int64_t Upper bound of bucket of the percentile (microseconds), 0 if
+ * histogram is empty
+ */
+int64_t perf_percentile(PerfHistogram_t const *hist, int percent);
+
+/**
+ * @brief Marks input arrival: getch returned, new loop cycle starts
+ * @param has_input 1 if getch returned a key, 0 on timeout
+ */
+void perf_cycle_start(int has_input);
+
+/**
+ * @brief Marks state transition: state machine is done with the input,
+ * records input latency of cycles started by a key
+ */
+void perf_transition(void);
+
+/**
+ * @brief Marks render completion: frame is sent, records frame time
+ */
+void perf_render_done(void);
+
+/**
+ * @brief Shows or hides debug panel
+ */
+void perf_toggle(void);
+
+/**
+ * @brief Counts call of engine function
+ * @param func Function
+ */
+void perf_count(PerfFunc_t func);
+
+/**
+ * @brief Records call of state handler
+ * @param from State the handler was called in
+ * @param to State after the handler
+ * @param start Time the handler was called (monotonic_ns())
+ */
+void perf_state_done(TetrisState_t from, TetrisState_t to, int64_t start);
+
+/**
+ * @brief Writes counters as JSON
+ * @param path File path
+ * @return int NO_ERROR on success, ERROR if file cannot be written
+ */
+int perf_dump(char const *path);
+
+/**
+ * @brief Path of counters dump: PERF_DUMP_ENV or PERF_DUMP_FILE
+ * @return char const* File path
+ */
+char const *perf_dump_path(void);
+
+/**
+ * @brief Requests counters dump on SIGUSR1
+ * @return int NO_ERROR on success, ERROR if handler cannot be installed
+ */
+int perf_install_dump_signal(void);
+
+/**
+ * @brief Writes counters dump to perf_dump_path() if SIGUSR1 was received
+ * since previous call
+ */
+void perf_poll_dump(void);
+
+#endif /* PERF_H */
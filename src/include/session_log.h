@@ -0,0 +1,158 @@
+/**
+ * @file session_log.h
+ * @brief Append-only log of finished games and its per-day compaction
+ * @details Every finished game appends one fixed size record to the session
+ * log at game over with a single O_APPEND write, no I/O is done while the game
+ * runs. Compaction aggregates the log into per-day summaries kept in a
+ * separate file sorted by day and replaces the log with an empty one. It runs
+ * at game over once the log holds SESSION_LOG_COMPACT_RECORDS records, or on
+ * demand with --compact-sessions, which also prints the summaries. Appends
+ * take a shared lock and compaction an exclusive one (fcntl), so games
+ * finished meanwhile by other instances are not lost. The summaries file
+ * records which log (inode) it has compacted up to which offset, so a log
+ * left in place by a crash after the summaries were written is not added
+ * twice. Both files are in host byte order.
+ */
+
+#ifndef SESSION_LOG_H
+#define SESSION_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * @brief Default file path of the session log
+ */
+#define SESSION_LOG_FILE "./out/sessions.bin"
+
+/**
+ * @brief Default file path of per-day summaries
+ */
+#define SESSION_DAYS_FILE "./out/session_days.bin"
+
+/**
+ * @brief Number of records in the session log that triggers compaction
+ */
+#define SESSION_LOG_COMPACT_RECORDS 1024
+
+/**
+ * @brief Number of records read from the session log at once by compaction
+ */
+#define SESSION_LOG_READ_RECORDS 256
+
+/**
+ * @brief Length of a summarized day (seconds)
+ */
+#define SESSION_DAY_SECONDS 86400
+
+/**
+ * @brief Command line option: compact the session log, print summaries, exit
+ */
+#define SESSION_COMPACT_OPTION "--compact-sessions"
+
+/**
+ * @brief Record of one finished game
+ */
+typedef struct {
+  int64_t end_time;       /**< Unix time the game ended (s) */
+  uint32_t seed;          /**< Seed the game started with */
+  int32_t score;          /**< Final score */
+  int32_t level;          /**< Final level */
+  int32_t clears[4];      /**< Clears of 1, 2, 3 and 4 rows */
+  int32_t pieces;         /**< Figures locked */
+  int32_t duration_ms;    /**< Time played without pauses (ms) */
+  int32_t inputs_per_min; /**< Actions of the player per minute played */
+} SessionRecord_t;
+
+_Static_assert(sizeof(SessionRecord_t) == 48,
+               "Session record must have no padding");
+
+/**
+ * @brief First word of the summaries file: "TSD1"
+ */
+#define SESSION_DAYS_MAGIC 0x31445354u
+
+/**
+ * @brief Header of the summaries file, followed by summaries sorted by day
+ */
+typedef struct {
+  uint32_t magic;     /**< SESSION_DAYS_MAGIC */
+  uint32_t version;   /**< Format version, 1 */
+  uint64_t log_ino;   /**< Inode of the last compacted session log */
+  int64_t log_offset; /**< Bytes of that log already added to summaries */
+} SessionDaysHeader_t;
+
+_Static_assert(sizeof(SessionDaysHeader_t) == 24,
+               "Session summaries header must have no padding");
+
+/**
+ * @brief Summary of games finished in one day (UTC)
+ */
+typedef struct {
+  int64_t day;         /**< Days since 1970-01-01 */
+  int64_t total_score; /**< Sum of final scores */
+  int64_t duration_ms; /**< Time played (ms) */
+  int64_t inputs;      /**< Actions, from inputs per minute and time */
+  int32_t games;       /**< Games finished */
+  int32_t best_score;  /**< Best final score */
+  int32_t best_level;  /**< Best final level */
+  int32_t clears[4];   /**< Clears of 1, 2, 3 and 4 rows */
+  int32_t pieces;      /**< Figures locked */
+} SessionDay_t;
+
+_Static_assert(sizeof(SessionDay_t) == 64,
+               "Session day summary must have no padding");
+
+/**
+ * @brief Files the game records finished games to
+ */
+typedef struct {
+  char const *log_path;  /**< Session log, SESSION_LOG_FILE */
+  char const *days_path; /**< Per-day summaries, SESSION_DAYS_FILE */
+} SessionLog_t;
+
+/**
+ * @brief Retrieves files of the session log
+ * @return SessionLog_t* Pointer to session log singleton
+ */
+SessionLog_t *updateSessionLog(void);
+
+/**
+ * @brief Appends a record to the session log with one write
+ * @param path File path of the session log
+ * @param record Record
+ * @return int Number of records in the log, -1 on error
+ */
+int session_log_append(char const *path, SessionRecord_t const *record);
+
+/**
+ * @brief Adds records of the session log to per-day summaries and replaces
+ * the log with an empty one
+ * @details Summaries are written to a temporary file renamed into place,
+ * together with the log inode and the offset compacted. The log is replaced
+ * only after that, records of a log that is still in place are not added
+ * again. A missing log leaves summaries as they are
+ * @param log_path File path of the session log
+ * @param days_path File path of per-day summaries
+ * @return int Number of days in summaries, -1 on error
+ */
+int session_log_compact(char const *log_path, char const *days_path);
+
+/**
+ * @brief Prints per-day summaries, one line per day
+ * @param days_path File path of per-day summaries
+ * @param out Output stream
+ * @return int Number of days printed, -1 if the file cannot be read
+ */
+int session_log_print(char const *days_path, FILE *out);
+
+/**
+ * @brief Appends the finished current game to the session log of
+ * updateSessionLog(), compacts the log into its per-day summaries when it is
+ * full
+ * @details Games that never locked a figure are not recorded
+ * @return int NO_ERROR on success or if nothing is recorded, ERROR otherwise
+ */
+int session_log_record(void);
+
+#endif /* SESSION_LOG_H */
@@ -33,13 +33,66 @@
  */
 #include "fsm.h"
 
+/**
+ * @ingroup core_modules
+ * @brief Frame time and input latency instrumentation
+ */
+#include "perf.h"
+
+/**
+ * @ingroup core_modules
+ * @brief Event loop: input, game timer and signals
+ */
+#include "events.h"
+
+/**
+ * @ingroup core_modules
+ * @brief Two-player versus mode over a Unix domain socket
+ */
+#include "versus.h"
+
+/**
+ * @ingroup core_modules
+ * @brief Spectator broadcast of board deltas over a Unix domain socket
+ */
+#include "broadcast.h"
+
+/**
+ * @ingroup core_modules
+ * @brief Lockstep deterministic netplay with input delay and rollback
+ */
+#include "netplay.h"
+
+/**
+ * @ingroup core_modules
+ * @brief Leaderboard of top scores in a memory-mapped binary file
+ */
+#include "leaderboard.h"
+
+/**
+ * @ingroup core_modules
+ * @brief Append-only log of finished games and its per-day compaction
+ */
+#include "session_log.h"
+
+/**
+ * @ingroup core_modules
+ * @brief Event trace ring buffers, compiled only with TRACE=1
+ */
+#include "trace.h"
+
 /**
  * @brief Conditional compilation for testing vs production
  * @details When USE_MOCK is defined, uses mock ncurses for unit testing.
- * Otherwise, includes the real ncurses library and frontend modules.
+ * Otherwise, includes the real ncurses library (or raw ANSI terminal layer when
+ * USE_ANSI is defined) and frontend modules.
  */
 #ifndef USE_MOCK
+#ifdef USE_ANSI
+#include "ansi_term.h" /**< Raw ANSI terminal layer for terminal UI */
+#else
 #include <ncurses.h> /**< Real ncurses library for terminal UI */
+#endif
 
 /**
  * @ingroup core_modules
@@ -62,11 +115,24 @@
  *
  *   "tetris.h" -> "backend.h";
  *   "tetris.h" -> "fsm.h";
+ *   "tetris.h" -> "perf.h";
+ *   "tetris.h" -> "versus.h";
+ *   "tetris.h" -> "broadcast.h";
+ *   "tetris.h" -> "netplay.h";
+ *   "tetris.h" -> "leaderboard.h";
+ *   "tetris.h" -> "session_log.h";
  *   "tetris.h" -> "frontend.h";
  *   "tetris.h" -> "defines.h";
+ *   "tetris.h" -> "ansi_term.h";
  *   "backend.h" -> "defines.h";
  *   "frontend.h" -> "defines.h";
  *   "fsm.h" -> "defines.h";
+ *   "perf.h" -> "defines.h";
+ *   "versus.h" -> "backend.h";
+ *   "versus.h" -> "fsm.h";
+ *   "broadcast.h" -> "defines.h";
+ *   "netplay.h" -> "backend.h";
+ *   "netplay.h" -> "versus.h";
  * }
  * @enddot
  */
@@ -0,0 +1,138 @@
+/**
+ * @file trace.h
+ * @brief Event trace ring buffers with Chrome trace export
+ * @details Built with TRACE=1 (make rebuild TRACE=1), every thread records
+ * begin/end events of state handlers, frame rendering, input reads and high
+ * score file I/O as (timestamp, event id, phase, argument) into its own fixed
+ * size ring buffer, the oldest events are overwritten. The rings are exported
+ * as Chrome trace JSON (chrome://tracing, Perfetto) on exit and on SIGUSR2.
+ * Built with TRACE=0 (default), all TRACE_* macros expand to nothing.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+/**
+ * @brief Tracing switch
+ * @details 1 - events are recorded, 0 - TRACE_* macros compile to nothing.
+ * Set with make TRACE=1 or -DTRACE=1
+ */
+#ifndef TRACE
+#define TRACE 0
+#endif
+
+#if TRACE
+
+#include <stdint.h>
+
+/**
+ * @brief Number of events kept per thread, power of two
+ */
+#define TRACE_EVENTS 4096
+
+/**
+ * @brief Maximum number of threads with ring buffers, events of further
+ * threads are dropped
+ */
+#define TRACE_THREADS 8
+
+/**
+ * @brief Default path of trace export, overridden by TRACE_ENV
+ */
+#define TRACE_FILE "./out/trace.json"
+
+/**
+ * @brief Environment variable with path of trace export
+ */
+#define TRACE_ENV "TETRIS_TRACE"
+
+/**
+ * @brief Traced events
+ */
+typedef enum {
+  TRACE_STATE = 0,     /**< State handler, argument - state */
+  TRACE_RENDER,        /**< Frame sent to the terminal */
+  TRACE_INPUT,         /**< Input read, end argument - key or ERR */
+  TRACE_HIGH_SCORE_IO, /**< High score file read/write */
+  TRACE_IDS            /**< Number of events */
+} TraceId_t;
+
+/**
+ * @brief Recorded event, 16 bytes
+ */
+typedef struct {
+  int64_t ts;    /**< Monotonic time, ns */
+  int32_t arg;   /**< Event argument */
+  uint16_t id;   /**< TraceId_t */
+  uint16_t type; /**< Chrome trace phase: 'B' - begin, 'E' - end */
+} TraceEvent_t;
+
+/**
+ * @brief Ring buffer of one thread
+ */
+typedef struct {
+  TraceEvent_t events[TRACE_EVENTS]; /**< Latest events */
+  uint32_t head;                     /**< Number of events ever recorded */
+  int tid;                           /**< Thread number in export */
+} TraceRing_t;
+
+/** @brief Records begin of event in ring buffer of calling thread */
+#define TRACE_BEGIN(id, arg) trace_record((id), 'B', (arg))
+
+/** @brief Records end of event in ring buffer of calling thread */
+#define TRACE_END(id, arg) trace_record((id), 'E', (arg))
+
+/** @brief Exports trace on SIGUSR2 */
+#define TRACE_INSTALL_SIGNAL() trace_install_export_signal()
+
+/** @brief Exports trace if SIGUSR2 was received */
+#define TRACE_POLL_EXPORT() trace_poll_export()
+
+/** @brief Exports trace to trace_path() */
+#define TRACE_EXPORT() trace_export(trace_path())
+
+/**
+ * @brief Records event in ring buffer of calling thread, the ring is created on
+ * first event of the thread
+ * @param id Event (TraceId_t)
+ * @param type Chrome trace phase: 'B' - begin, 'E' - end
+ * @param arg Event argument
+ */
+void trace_record(TraceId_t id, char type, int arg);
+
+/**
+ * @brief Writes events of all ring buffers as Chrome trace JSON
+ * @param path File path
+ * @return int NO_ERROR on success, ERROR if file cannot be written
+ */
+int trace_export(char const *path);
+
+/**
+ * @brief Path of trace export: TRACE_ENV or TRACE_FILE
+ * @return char const* File path
+ */
+char const *trace_path(void);
+
+/**
+ * @brief Requests trace export on SIGUSR2
+ * @return int NO_ERROR on success, ERROR if handler cannot be installed
+ */
+int trace_install_export_signal(void);
+
+/**
+ * @brief Writes trace export to trace_path() if SIGUSR2 was received since
+ * previous call
+ */
+void trace_poll_export(void);
+
+#else
+
+#define TRACE_BEGIN(id, arg) ((void)0)
+#define TRACE_END(id, arg) ((void)0)
+#define TRACE_INSTALL_SIGNAL() ((void)0)
+#define TRACE_POLL_EXPORT() ((void)0)
+#define TRACE_EXPORT() ((void)0)
+
+#endif /* TRACE */
+
+#endif /* TRACE_H */
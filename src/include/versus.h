@@ -0,0 +1,189 @@
+/**
+ * @file versus.h
+ * @brief Two-player versus mode over a Unix domain socket
+ * @details Two games on one host are started with --versus PATH. The first one
+ * listens on the socket PATH, the second one connects to it; each game starts
+ * at once and plays on while the peer is missing. Peers exchange fixed size
+ * VERSUS_MSG_SIZE byte messages: inputs, garbage rows sent by multi-row
+ * clears, board digests after each locked figure and game over. Socket is
+ * non-blocking and watched by the event loop, messages are queued when the
+ * socket is full. The local game never waits on the peer: when the queue is
+ * full too, queued inputs and digests are dropped to make room for other
+ * messages, garbage and game over that still do not fit are kept aside and
+ * queued by the next flush. Received garbage rows are inserted at the bottom
+ * of the field before the next figure spawns, rows cleared meanwhile cancel
+ * them first.
+ */
+
+#ifndef VERSUS_H
+#define VERSUS_H
+
+#include <stdint.h>
+
+#include "backend.h"
+#include "fsm.h"
+
+/**
+ * @brief Size of one message on the socket (bytes)
+ */
+#define VERSUS_MSG_SIZE 8
+
+/**
+ * @brief Size of send queue: messages not yet accepted by the socket (bytes)
+ */
+#define VERSUS_TX_SIZE (64 * VERSUS_MSG_SIZE)
+
+/**
+ * @brief Size of receive buffer (bytes)
+ */
+#define VERSUS_RX_SIZE (32 * VERSUS_MSG_SIZE)
+
+/**
+ * @brief Command line option of versus mode, followed by socket path
+ */
+#define VERSUS_OPTION "--versus"
+
+/**
+ * @brief Message types
+ */
+typedef enum {
+  VERSUS_MSG_INPUT = 1, /**< Action of the peer, arg - UserAction_t */
+  VERSUS_MSG_GARBAGE,   /**< Garbage rows for the receiver, arg - rows */
+  VERSUS_MSG_DIGEST,    /**< Field after lock, value - stack height, data -
+                           field digest */
+  VERSUS_MSG_GAMEOVER,  /**< Peer game is over, receiver wins */
+  VERSUS_MSG_SEED,      /**< Netplay start, data - seed of both games */
+  VERSUS_MSG_LOCKSTEP   /**< Netplay input, arg - UserAction_t, value - frame
+                           (low 16 bits) */
+} VersusMsgType_t;
+
+/**
+ * @brief Message, VERSUS_MSG_SIZE bytes on the socket: type, arg, value (16
+ * bits) and data (32 bits), little-endian
+ */
+typedef struct {
+  uint8_t type;   /**< VersusMsgType_t */
+  uint8_t arg;    /**< Action or garbage rows */
+  uint16_t value; /**< Stack height or frame */
+  uint32_t data;  /**< Field digest or seed */
+} VersusMsg_t;
+
+/**
+ * @brief State of versus mode
+ */
+typedef struct {
+  int active;                 /**< 1 if versus mode is on */
+  int listen_fd;              /**< Socket waiting for peer, -1 if none */
+  int fd;                     /**< Socket of connected peer, -1 if none */
+  char path[108];             /**< Socket path, unlinked by listening side */
+  uint8_t tx[VERSUS_TX_SIZE]; /**< Messages not yet sent */
+  int tx_len;                 /**< Bytes in send queue */
+  uint8_t rx[VERSUS_RX_SIZE]; /**< Received bytes, partial message last */
+  int rx_len;                 /**< Bytes in receive buffer */
+  int pending_garbage;        /**< Received rows not inserted yet */
+  int sent_garbage;           /**< Rows sent to the peer */
+  int peer_height;            /**< Stack height of the peer */
+  uint32_t peer_digest;       /**< Field digest of the peer */
+  int peer_inputs;            /**< Actions made by the peer */
+  int peer_over;              /**< 1 if peer game is over */
+  int dropped;                /**< Messages dropped on full queue */
+  int unsent_garbage;         /**< Sent rows waiting for room in the queue */
+  int unsent_over;            /**< 1 if game over waits for room */
+} Versus_t;
+
+/**
+ * @brief Retrieves state of versus mode
+ * @return Versus_t* Pointer to versus mode singleton
+ */
+Versus_t *updateVersus(void);
+
+/**
+ * @brief Starts versus mode: connects to the peer listening on path or
+ * listens there for the peer, the socket is watched by the event loop
+ * @param path Socket path
+ * @return int NO_ERROR on success, ERROR if socket cannot be created
+ */
+int versus_init(char const *path);
+
+/**
+ * @brief Closes sockets, listening side removes the socket path
+ */
+void versus_free(void);
+
+/**
+ * @brief Writes message to VERSUS_MSG_SIZE bytes
+ * @param msg Message
+ * @param buf Output buffer
+ */
+void versus_encode(VersusMsg_t msg, uint8_t *buf);
+
+/**
+ * @brief Reads message from VERSUS_MSG_SIZE bytes
+ * @param buf Input buffer
+ * @return VersusMsg_t Message
+ */
+VersusMsg_t versus_decode(uint8_t const *buf);
+
+/**
+ * @brief Queues message for the peer and sends queued ones without blocking
+ * @param msg Message
+ * @details Does nothing while no peer is connected, never blocks. On full
+ * queue inputs and digests are dropped for other messages, garbage and game
+ * over that still do not fit are queued by a later flush
+ */
+void versus_send(VersusMsg_t msg);
+
+/**
+ * @brief Handler of versus sockets for the event loop: accepts the peer,
+ * reads and applies its messages
+ * @param fd Readable socket
+ * @return int ESCAPE if the peer game is over (local game ends), INPUT_NONE
+ * otherwise
+ */
+int versus_on_ready(int fd);
+
+/**
+ * @brief Sends action of the local player
+ * @param action Action
+ */
+void versus_send_input(UserAction_t action);
+
+/**
+ * @brief Sends garbage for rows cleared by the locked figure: pending garbage
+ * is cancelled first, the rest goes to the peer
+ * @param n_rows Number of rows cleared
+ */
+void versus_rows_cleared(int n_rows);
+
+/**
+ * @brief Inserts pending garbage into the field and sends field digest
+ * @details Called after the figure is locked, before next one spawns
+ */
+void versus_figure_locked(void);
+
+/**
+ * @brief Tells the peer that local game is over
+ */
+void versus_game_over(void);
+
+/**
+ * @brief Garbage rows sent for a clear: 2 rows - 1, 3 rows - 2, 4 rows - 4
+ * @param n_rows Number of rows cleared
+ * @return int Garbage rows
+ */
+int versus_garbage_for(int n_rows);
+
+/**
+ * @brief Digest of the visible field (FNV-1a of cells)
+ * @return uint32_t Digest
+ */
+uint32_t versus_field_digest(void);
+
+/**
+ * @brief Height of the stack of a game
+ * @param st Game
+ * @return int Visible rows from the bottom to the highest filled cell
+ */
+int versus_stack_height(GameState_t const *st);
+
+#endif /* VERSUS_H */
@@ -6,9 +6,19 @@
  * and game mechanics validation.
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <check.h>
+#include <fcntl.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "../include/tetris.h"
 
@@ -42,7 +52,7 @@ START_TEST(test_updateFigure) {
   int **figure1 = updateFigure();
   int **figure2 = updateFigure();
   ck_assert_ptr_eq(figure1, figure2);
-  free_field(figure2);
+  free_game();
 }
 END_TEST
 
@@ -106,7 +116,6 @@ START_TEST(test_copy_next_figure_to_figure) {
     for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++)
       sum_of_pixels += figure[i][j];
   ck_assert_int_eq(sum_of_pixels, 4);
-  free_field(figure);
   free_game();
 }
 END_TEST
@@ -114,31 +123,209 @@ END_TEST
 /**
  * @brief Test for high score update functionality
  * @test Verifies that high score is properly updated and saved
- * @pre Game should be initialized with valid high score file
+ * @pre Game should be initialized with valid leaderboard file
  * @post Game state should transition correctly based on file operations
  */
 START_TEST(test_high_score_update) {
   TetrisState_t *state = updateTetrisState();
-  GameInfo_t *game = updateCurrentState();
-  int **figure = updateFigure();
+  GameState_t *game = updateGameState();
+  updateFigure();
   updateFigurePosition();
   init_game();
   *state = SPAWN;
   game->score = 100;
   game->high_score = 0;
   userInput(No_signal, false);
-  FILE *record_note_r = fopen(HIGH_SCORE_FILE, "r+");
-  if (record_note_r) {
+  FILE *leaderboard_file = fopen(updateLeaderboard()->path, "r+");
+  if (leaderboard_file) {
     ck_assert_int_eq(*updateTetrisState(), MOVING);
-    fclose(record_note_r);
+    fclose(leaderboard_file);
   } else
     ck_assert_int_eq(*updateTetrisState(), EXIT_ERROR);
 
-  free_field(figure);
   free_game();
 }
 END_TEST
 
+/**
+ * @brief Test for leaderboard file
+ * @test Games are kept sorted by score, only LEADERBOARD_SIZE best ones, the
+ * file keeps them after reopen, file of other format is refused
+ * @pre Leaderboard file should not exist
+ * @post Finished game is recorded with its rank
+ */
+START_TEST(test_leaderboard) {
+  char path[] = "/tmp/tetris_leaderboard_XXXXXX";
+  close(mkstemp(path));
+  unlink(path);
+  ck_assert_int_eq(leaderboard_open(path), NO_ERROR);
+  ck_assert_int_eq(leaderboard_top_score(), 0);
+  LeaderboardEntry_t entry = {.name = "test"};
+  ck_assert_int_eq(leaderboard_insert(&entry), -1);
+  for (int i = 1; i <= LEADERBOARD_SIZE + 8; i++) {
+    entry.score = (i * 37) % 101 * 10 + 10;
+    entry.seed = i;
+    int rank = leaderboard_rank(entry.score);
+    ck_assert_int_eq(leaderboard_insert(&entry),
+                     (rank < LEADERBOARD_SIZE) ? rank : -1);
+  }
+  LeaderboardTable_t const *table = leaderboard_table();
+  ck_assert_int_eq(table->count, LEADERBOARD_SIZE);
+  for (int i = 1; i < LEADERBOARD_SIZE; i++)
+    ck_assert_int_gt(table->entries[i - 1].score, table->entries[i].score);
+  int top = table->entries[0].score;
+  ck_assert_int_eq(leaderboard_rank(top + 1), 0);
+  ck_assert_int_eq(leaderboard_rank(top), 1);
+  entry.score = table->entries[LEADERBOARD_SIZE - 1].score;
+  ck_assert_int_eq(leaderboard_insert(&entry), -1);
+  uint32_t generation = updateLeaderboard()->file->generation;
+  leaderboard_close();
+
+  ck_assert_int_eq(leaderboard_open(path), NO_ERROR);
+  ck_assert_int_eq(leaderboard_top_score(), top);
+  ck_assert_int_eq(updateLeaderboard()->file->generation, generation);
+  init_game();
+  GameState_t *game = updateGameState();
+  game->score = top + 10;
+  game->lines = 12;
+  ck_assert_int_eq(leaderboard_record(), 0);
+  ck_assert_int_eq(leaderboard_table()->entries[0].lines, 12);
+  ck_assert_uint_eq(leaderboard_table()->entries[0].seed, game->start_seed);
+  game->high_score = 0;
+  game->score = 0;
+  ck_assert_int_eq(high_score_update(), NO_ERROR);
+  ck_assert_int_eq(game->high_score, top + 10);
+  leaderboard_close();
+
+  FILE *text = fopen(path, "w");
+  fprintf(text, "%d", top);
+  fclose(text);
+  ck_assert_int_eq(leaderboard_open(path), ERROR);
+  ck_assert_ptr_null(leaderboard_table());
+  unlink(path);
+  free_game();
+}
+END_TEST
+
+/**
+ * @brief Test for leaderboard updates of instances running at once
+ * @test Processes open the missing leaderboard file and insert games at the
+ * same time
+ * @pre Leaderboard file should not exist
+ * @post Every game is in the leaderboard, no temporary file is left
+ */
+START_TEST(test_leaderboard_concurrent) {
+  char dir[] = "/tmp/tetris_leaderboard_XXXXXX";
+  char path[64];
+  int const n_proc = 4;
+  int const n_games = 12;
+  ck_assert_ptr_nonnull(mkdtemp(dir));
+  snprintf(path, sizeof(path), "%s/leaderboard.bin", dir);
+  for (int p = 0; p < n_proc; p++)
+    if (fork() == 0) {
+      int error = leaderboard_open(path);
+      LeaderboardEntry_t entry = {.name = "test"};
+      for (int i = 0; i < n_games && error == NO_ERROR; i++) {
+        entry.score = 10 + p + n_proc * i;
+        if (leaderboard_insert(&entry) < 0) error = ERROR;
+      }
+      _exit(error);
+    }
+  for (int p = 0; p < n_proc; p++) {
+    int status = 0;
+    wait(&status);
+    ck_assert(WIFEXITED(status) && WEXITSTATUS(status) == NO_ERROR);
+  }
+  ck_assert_int_eq(leaderboard_open(path), NO_ERROR);
+  LeaderboardTable_t const *table = leaderboard_table();
+  ck_assert_int_eq(table->count, n_proc * n_games);
+  for (int i = 0; i < n_proc * n_games; i++)
+    ck_assert_int_eq(table->entries[i].score, 10 + n_proc * n_games - 1 - i);
+  leaderboard_close();
+  unlink(path);
+  ck_assert_int_eq(rmdir(dir), 0);
+}
+END_TEST
+
+/**
+ * @brief Test for session log and its compaction
+ * @test Records of three days are appended, compaction sums them by day and
+ * empties the log, log restored as after a crash before it was emptied is not
+ * added again, next compaction adds to existing summaries
+ * @pre Session log and summaries should not exist
+ * @post Summaries are sorted by day and printed one line per day
+ */
+START_TEST(test_session_log) {
+  char dir[] = "/tmp/tetris_sessions_XXXXXX";
+  char log[64];
+  char days_path[64];
+  ck_assert_ptr_nonnull(mkdtemp(dir));
+  snprintf(log, sizeof(log), "%s/sessions.bin", dir);
+  snprintf(days_path, sizeof(days_path), "%s/days.bin", dir);
+  ck_assert_int_eq(session_log_compact(log, days_path), 0);
+  int64_t const day = 20000;
+  int64_t const order[] = {2, 0, 2, 1, 2};
+  for (int i = 0; i < 5; i++) {
+    SessionRecord_t record = {
+        .end_time = (day + order[i]) * SESSION_DAY_SECONDS + i * 60,
+        .score = 100 * (i + 1),
+        .level = i + 1,
+        .clears = {i, 0, 0, 1},
+        .pieces = 10,
+        .duration_ms = 60000,
+        .inputs_per_min = 30};
+    ck_assert_int_eq(session_log_append(log, &record), i + 1);
+  }
+  char saved[72];
+  snprintf(saved, sizeof(saved), "%s.saved", log);
+  ck_assert_int_eq(link(log, saved), 0);
+  ck_assert_int_eq(session_log_compact(log, days_path), 3);
+  struct stat sb;
+  ck_assert_int_eq(stat(log, &sb), 0);
+  ck_assert_int_eq(sb.st_size, 0);
+  /** Crash before the log is replaced: compacted records are skipped */
+  ck_assert_int_eq(rename(saved, log), 0);
+  ck_assert_int_eq(session_log_compact(log, days_path), 3);
+  ck_assert_int_eq(stat(log, &sb), 0);
+  ck_assert_int_eq(sb.st_size, 0);
+  SessionRecord_t late = {.end_time = day * SESSION_DAY_SECONDS,
+                          .score = 50,
+                          .pieces = 1};
+  ck_assert_int_eq(session_log_append(log, &late), 1);
+  ck_assert_int_eq(session_log_compact(log, days_path), 3);
+
+  SessionDay_t days[4];
+  FILE *in = fopen(days_path, "rb");
+  ck_assert_ptr_nonnull(in);
+  SessionDaysHeader_t header;
+  ck_assert_int_eq(fread(&header, sizeof(header), 1, in), 1);
+  ck_assert_int_eq(fread(days, sizeof(days[0]), 4, in), 3);
+  fclose(in);
+  ck_assert_int_eq(days[0].day, day);
+  ck_assert_int_eq(days[0].games, 2);
+  ck_assert_int_eq(days[0].total_score, 250);
+  ck_assert_int_eq(days[0].pieces, 11);
+  ck_assert_int_eq(days[1].day, day + 1);
+  ck_assert_int_eq(days[1].best_level, 4);
+  ck_assert_int_eq(days[2].games, 3);
+  ck_assert_int_eq(days[2].best_score, 500);
+  ck_assert_int_eq(days[2].clears[0], 0 + 2 + 4);
+  ck_assert_int_eq(days[2].clears[3], 3);
+  ck_assert_int_eq(days[2].duration_ms, 3 * 60000);
+  ck_assert_int_eq(days[2].inputs, 3 * 30);
+
+  char buf[1024] = "";
+  FILE *out = fmemopen(buf, sizeof(buf), "w");
+  ck_assert_int_eq(session_log_print(days_path, out), 3);
+  fclose(out);
+  ck_assert_ptr_nonnull(strstr(buf, "2024-10-04 games    2 best     200"));
+  ck_assert_ptr_nonnull(strstr(buf, "clears 6/0/0/3 pieces     30"));
+  unlink(log);
+  unlink(days_path);
+  ck_assert_int_eq(rmdir(dir), 0);
+}
+END_TEST
+
 /**
  * @brief Test for score recalculation
  * @test Different finishedrows give different score
@@ -147,7 +334,7 @@ END_TEST
  */
 START_TEST(test_recalculate_stats) {
   TetrisState_t *state = updateTetrisState();
-  GameInfo_t *game = updateCurrentState();
+  GameState_t *game = updateGameState();
   updateFigurePosition();
   init_game();
   *state = ATTACHING;
@@ -186,6 +373,141 @@ START_TEST(test_shift_rows_down) {
 }
 END_TEST
 
+/**
+ * @brief Test for rotation with wall kicks
+ * @test Vertical stick near the left wall is kicked right on rotation, stick in
+ * a filled field is not rotated at all. Stick at a wall next to the stack
+ * takes the exact SRS L -> 2 kick
+ * @pre Game should be initialized, current figure is the I figure in L state
+ * @post Figure position and rotation state change only on successful rotation
+ */
+START_TEST(test_rotate_figure_with_kicks) {
+  GameInfo_t *game = updateCurrentState();
+  GameContext_t *context = updateGameContext();
+  int **figure = updateFigure();
+  FigurePos_t *fig_pos = updateFigurePosition();
+  init_game();
+  int stick_fig[16] = {0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0};
+  for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++)
+    for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++)
+      figure[i][j] = stick_fig[i * 4 + j];
+  context->figure_type = 0;
+  context->figure_rotation = 1;
+  fig_pos->x = -1;
+  fig_pos->y = 5;
+  ck_assert_int_eq(check_collide(), false);
+  ck_assert_int_eq(rotate_figure_with_kicks(), true);
+  ck_assert_int_eq(context->figure_rotation, 2);
+  ck_assert_int_eq(fig_pos->x, 0);
+  ck_assert_int_eq(fig_pos->y, 5);
+  ck_assert_int_eq(check_collide(), false);
+
+  for (int i = 0; i < ROWS_MAP * COLS_MAP; i++)
+    game->field[i / COLS_MAP][i % COLS_MAP] = (i % COLS_MAP) ? 1 : 0;
+  context->figure_rotation = 1;
+  fig_pos->x = -1;
+  ck_assert_int_eq(rotate_figure_with_kicks(), false);
+  ck_assert_int_eq(context->figure_rotation, 1);
+  ck_assert_int_eq(fig_pos->x, -1);
+
+  /** I from state L: right wall and stack under the row kick it one down */
+  for (int i = 0; i < ROWS_MAP * COLS_MAP; i++)
+    game->field[i / COLS_MAP][i % COLS_MAP] = 0;
+  for (int j = COLS_MAP - 4; j < COLS_MAP - 1; j++) game->field[7][j] = 1;
+  for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++)
+    for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++)
+      figure[i][j] = stick_fig[i * 4 + j];
+  context->figure_rotation = 1;
+  fig_pos->x = COLS_MAP - 2;
+  fig_pos->y = 5;
+  ck_assert_int_eq(check_collide(), false);
+  ck_assert_int_eq(rotate_figure_with_kicks(), true);
+  ck_assert_int_eq(context->figure_rotation, 2);
+  ck_assert_int_eq(fig_pos->x, COLS_MAP - 4);
+  ck_assert_int_eq(fig_pos->y, 6);
+
+  /** I from state L: left wall and stack in the row kick it two up */
+  for (int i = 0; i < ROWS_MAP * COLS_MAP; i++)
+    game->field[i / COLS_MAP][i % COLS_MAP] = 0;
+  game->field[7][2] = 1;
+  for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++)
+    for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++)
+      figure[i][j] = stick_fig[i * 4 + j];
+  context->figure_rotation = 1;
+  fig_pos->x = -1;
+  fig_pos->y = 5;
+  ck_assert_int_eq(check_collide(), false);
+  ck_assert_int_eq(rotate_figure_with_kicks(), true);
+  ck_assert_int_eq(context->figure_rotation, 2);
+  ck_assert_int_eq(fig_pos->x, 0);
+  ck_assert_int_eq(fig_pos->y, 3);
+  free_game();
+}
+END_TEST
+
+/**
+ * @brief Test for layout of screen panels
+ * @test Layout is centered in the terminal, terminal larger than the screen
+ * buffer centers it in the buffer, small terminal does not fit
+ * @pre None
+ * @post Layout generation is counted
+ */
+START_TEST(test_compute_layout) {
+  Layout_t layout = {0};
+  compute_layout(&layout, LAYOUT_H + 10, LAYOUT_W + 20, 0, 0);
+  ck_assert_int_eq(layout.board_y, 5);
+  ck_assert_int_eq(layout.board_x, 10);
+  ck_assert_int_eq(layout.panel_x, 10 + BOARD_WIN_W);
+  ck_assert_int_eq(layout.fits, 1);
+
+  compute_layout(&layout, 200, 300, LAYOUT_H + 4, LAYOUT_W + 8);
+  ck_assert_int_eq(layout.lines, LAYOUT_H + 4);
+  ck_assert_int_eq(layout.cols, LAYOUT_W + 8);
+  ck_assert_int_eq(layout.board_y, 2);
+  ck_assert_int_eq(layout.board_x, 4);
+  ck_assert_int_le(layout.perf_y + PERF_WIN_H, LAYOUT_H + 4);
+  ck_assert_int_le(layout.board_x + PERF_WIN_W, LAYOUT_W + 8);
+  ck_assert_int_eq(layout.fits, 1);
+
+  compute_layout(&layout, LAYOUT_H - 1, 300, LAYOUT_H + 4, LAYOUT_W + 8);
+  ck_assert_int_eq(layout.fits, 0);
+  ck_assert_int_eq(layout.generation, 3);
+}
+END_TEST
+
+/**
+ * @brief Test for arena recycling
+ * @test Freed game returns its arena to the pool, next game reuses it cleared
+ * @pre Game should be initialized and its field and figure changed
+ * @post Next game has the same matrices, all cells are 0
+ */
+START_TEST(test_arena_pool) {
+  GameInfo_t *game = updateCurrentState();
+  init_game();
+  cell_t **field = game->field;
+  int **next = game->next;
+  int **figure = updateFigure();
+  game->field[ROWS_MAP - 1][0] = 1;
+  game->field[-HIDDEN_ROWS][COLS_MAP - 1] = 1;
+  figure[1][1] = 1;
+  free_game();
+  ck_assert_ptr_null(game->field);
+  ck_assert_ptr_null(game->next);
+
+  init_game();
+  ck_assert_ptr_eq(game->field, field);
+  ck_assert_ptr_eq(game->next, next);
+  ck_assert_ptr_eq(updateFigure(), figure);
+  int sum = 0;
+  for (int i = -HIDDEN_ROWS; i < ROWS_MAP; i++)
+    for (int j = 0; j < COLS_MAP; j++) sum += game->field[i][j];
+  ck_assert_int_eq(sum, 0);
+  ck_assert_int_eq(figure[1][1], 0);
+  exit_game();
+  ck_assert_ptr_null(game->field);
+}
+END_TEST
+
 // ===================
 // TEST FSM
 // ===================
@@ -227,7 +549,7 @@ END_TEST
 START_TEST(test_on_spawn_state) {
   TetrisState_t *state = updateTetrisState();
   GameInfo_t *game = updateCurrentState();
-  int **figure = updateFigure();
+  updateFigure();
   updateFigurePosition();
 
   init_game();
@@ -237,10 +559,10 @@ START_TEST(test_on_spawn_state) {
   init_figure_position();
   userInput(No_signal, false);
 
-  FILE *record_note_r = fopen(HIGH_SCORE_FILE, "r+");
-  if (record_note_r) {
+  FILE *leaderboard_file = fopen(updateLeaderboard()->path, "r+");
+  if (leaderboard_file) {
     ck_assert_int_eq(*updateTetrisState(), MOVING);
-    fclose(record_note_r);
+    fclose(leaderboard_file);
   } else
     ck_assert_int_eq(*updateTetrisState(), EXIT_ERROR);
 
@@ -249,14 +571,13 @@ START_TEST(test_on_spawn_state) {
   for (int i = 0; i < ROWS_MAP * COLS_MAP; i++)
     game->field[i / COLS_MAP][i % COLS_MAP] = 1;
   userInput(No_signal, false);
-  record_note_r = fopen(HIGH_SCORE_FILE, "r+");
-  if (record_note_r) {
+  leaderboard_file = fopen(updateLeaderboard()->path, "r+");
+  if (leaderboard_file) {
     ck_assert_int_eq(*updateTetrisState(), GAMEOVER);
-    fclose(record_note_r);
+    fclose(leaderboard_file);
   } else
     ck_assert_int_eq(*updateTetrisState(), EXIT_ERROR);
 
-  free_field(figure);
   free_game();
 }
 END_TEST
@@ -296,9 +617,13 @@ START_TEST(test_on_moving_state) {
   userInput(No_signal, false);
   ck_assert_int_eq(*updateTetrisState(), MOVING);
   userInput(Pause, false);
-  ck_assert_int_eq(*updateTetrisState(), SHIFTING);
+  ck_assert_int_eq(*updateTetrisState(), PAUSED);
+  ck_assert_int_eq(updateGameState()->pause, true);
+  userInput(No_signal, false);
+  ck_assert_int_eq(*updateTetrisState(), PAUSED);
   userInput(Pause, false);
   ck_assert_int_eq(*updateTetrisState(), MOVING);
+  ck_assert_int_eq(updateGameState()->pause, false);
   userInput(Down, false);
   ck_assert_int_eq(*updateTetrisState(), SHIFTING);
   userInput(No_signal, false);
@@ -318,7 +643,6 @@ START_TEST(test_on_moving_state) {
     for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++)
       figure[i][j] = stick_fig[i * 4 + j];
   fig_pos->y = 1;
-  free_field(figure);
   free_game();
 }
 END_TEST
@@ -333,7 +657,7 @@ START_TEST(test_on_shifting_state) {
   TetrisState_t *state = updateTetrisState();
   GameInfo_t *game = updateCurrentState();
   int **figure = updateFigure();
-  updateFigurePosition();
+  FigurePos_t *fig_pos = updateFigurePosition();
 
   init_game();
   int stick_fig[16] = {0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0};
@@ -343,8 +667,11 @@ START_TEST(test_on_shifting_state) {
   for (int i = 0; i < ROWS_MAP * COLS_MAP; i++)
     game->field[i / COLS_MAP][i % COLS_MAP] =
         (i < COLS_MAP * 5 && i % COLS_MAP) ? 0 : 1;
+  updateGameContext()->figure_rotation = 3;
   *state = SHIFTING;
   init_figure_position();
+  ck_assert_int_eq(fig_pos->y, -3);
+  fig_pos->y = 0;
 
   userInput(No_signal, false);
   ck_assert_int_eq(*updateTetrisState(), MOVING);
@@ -352,10 +679,612 @@ START_TEST(test_on_shifting_state) {
   userInput(No_signal, false);
   ck_assert_int_eq(*updateTetrisState(), SHIFTING);
 
+  userInput(No_signal, false);
+  ck_assert_int_eq(*updateTetrisState(), MOVING);
+
+  updateGameContext()->lock_start -= LOCK_DELAY_MS;
+  userInput(No_signal, false);
+  ck_assert_int_eq(*updateTetrisState(), SHIFTING);
   userInput(No_signal, false);
   ck_assert_int_eq(*updateTetrisState(), ATTACHING);
 
-  free_field(figure);
+  free_game();
+}
+END_TEST
+
+/**
+ * @brief Test for lock delay restarts
+ * @test Moves of grounded figure restart lock delay only LOCK_MOVE_RESETS
+ * times, falling to a new lowest row gives restarts back
+ * @pre Lock delay of grounded figure is started
+ * @post Lock delay expires once restarts are used up
+ */
+START_TEST(test_lock_delay) {
+  GameContext_t *context = updateGameContext();
+  FigurePos_t *fig_pos = updateFigurePosition();
+  fig_pos->y = 3;
+  lock_delay_reset();
+  ck_assert_int_eq(lock_delay_expired(), false);
+  ck_assert_int_eq(context->lock_active, true);
+  for (int i = 0; i < LOCK_MOVE_RESETS; i++) {
+    context->lock_start -= LOCK_DELAY_MS;
+    lock_delay_on_move();
+    ck_assert_int_eq(lock_delay_expired(), false);
+  }
+  context->lock_start -= LOCK_DELAY_MS;
+  lock_delay_on_move();
+  ck_assert_int_eq(lock_delay_expired(), true);
+  ck_assert_int_eq(lock_delay_remaining(), 0);
+
+  fig_pos->y++;
+  lock_delay_on_fall();
+  ck_assert_int_eq(context->lock_active, false);
+  ck_assert_int_eq(context->lock_resets, 0);
+  ck_assert_int_eq(context->lowest_y, 4);
+  ck_assert_int_eq(lock_delay_expired(), false);
+  ck_assert_int_gt(lock_delay_remaining(), 0);
+  lock_delay_force();
+  ck_assert_int_eq(lock_delay_expired(), true);
+}
+END_TEST
+
+/**
+ * @brief Test for gravity curve and multi-row gravity
+ * @test Levels past MAX_LEVEL keep the fastest tick and raise gravity, 1.5
+ * rows per tick alternate falls by 1 and 2 rows, 20G drops to the stack
+ * @pre Game should be initialized with figure at its start position
+ * @post Figure never falls deeper than drop_distance()
+ */
+START_TEST(test_gravity) {
+  TetrisState_t *state = updateTetrisState();
+  GameState_t *game = updateGameState();
+  GameContext_t *context = updateGameContext();
+  FigurePos_t *fig_pos = updateFigurePosition();
+  init_game();
+  ck_assert_int_eq(game->speed, INITIAL_TIMEOUT);
+  ck_assert_int_eq(context->gravity, GRAVITY_UNIT);
+  game->score = 600 * MAX_LEVEL;
+  recalculate_stats(1);
+  ck_assert_int_eq(game->level, MAX_LEVEL + 1);
+  ck_assert_int_eq(game->speed,
+                   INITIAL_TIMEOUT - (MAX_LEVEL - 1) * SPEED_DECREMENT);
+  ck_assert_int_eq(context->gravity, GRAVITY_UNIT * 3 / 2);
+
+  assign_next_figure();
+  copy_next_figure_to_figure();
+  init_figure_position();
+  int start_y = fig_pos->y;
+  int distance = drop_distance();
+  *state = SHIFTING;
+  userInput(No_signal, false);
+  ck_assert_int_eq(fig_pos->y, start_y + 1);
+  *state = SHIFTING;
+  userInput(No_signal, false);
+  ck_assert_int_eq(fig_pos->y, start_y + 3);
+  ck_assert_int_eq(drop_distance(), distance - 3);
+
+  context->gravity = GRAVITY_20G;
+  *state = SHIFTING;
+  userInput(No_signal, false);
+  ck_assert_int_eq(*updateTetrisState(), MOVING);
+  ck_assert_int_eq(fig_pos->y, start_y + distance);
+  ck_assert_int_eq(drop_distance(), 0);
+  ck_assert_int_eq(check_collide(), false);
+  fig_pos->y++;
+  ck_assert_int_eq(check_collide(), true);
+  free_game();
+}
+END_TEST
+
+/**
+ * @brief Test for hidden buffer rows
+ * @test Figure spawns with its lowest row on the top visible row and may stay
+ * in hidden rows, figure locked entirely in hidden rows ends the game
+ * @pre Game should be initialized, current figure is the I figure in L state
+ * @post Rows above hidden buffer still collide
+ */
+START_TEST(test_hidden_rows) {
+  TetrisState_t *state = updateTetrisState();
+  GameInfo_t *game = updateCurrentState();
+  GameContext_t *context = updateGameContext();
+  FigurePos_t *fig_pos = updateFigurePosition();
+  init_game();
+  int **figure = updateFigure();
+  for (int i = 0; i < SIDE_OF_FIGURE_SQUARE * SIDE_OF_FIGURE_SQUARE; i++)
+    figure[i / 4][i % 4] = (i % 4 == 1);
+  context->figure_type = 0;
+  context->figure_rotation = 1;
+  init_figure_position();
+  ck_assert_int_eq(fig_pos->x, FIGURESTART_X - 1);
+  ck_assert_int_eq(fig_pos->y, -3);
+  for (int j = 0; j < COLS_MAP; j++) game->field[0][j] = (j != FIGURESTART_X);
+  ck_assert_int_eq(check_collide(), false);
+  ck_assert_int_eq(check_lock_out(), false);
+  fig_pos->y = -HIDDEN_ROWS;
+  ck_assert_int_eq(check_collide(), false);
+  ck_assert_int_eq(check_lock_out(), true);
+  fig_pos->y--;
+  ck_assert_int_eq(check_collide(), true);
+
+  fig_pos->y = -HIDDEN_ROWS;
+  *state = ATTACHING;
+  userInput(No_signal, false);
+  ck_assert_int_eq(*updateTetrisState(), GAMEOVER);
+  ck_assert_int_eq(game->field[-1][FIGURESTART_X], PIECE_ID(0));
+  ck_assert_int_eq(game->field[-HIDDEN_ROWS][FIGURESTART_X], PIECE_ID(0));
+  free_game();
+}
+END_TEST
+
+/**
+ * @brief Test for piece id in field cells
+ * @test Attached figure writes its piece id, shifted rows keep piece ids
+ * @pre Game should be initialized with empty field
+ * @post Cells hold piece id of figure that filled them
+ */
+START_TEST(test_attach_piece_id) {
+  GameInfo_t *game = updateCurrentState();
+  GameContext_t *context = updateGameContext();
+  FigurePos_t *fig_pos = updateFigurePosition();
+  init_game();
+  for (int type = 0; type < NUMBER_OF_FIGURES; type++) {
+    do assign_next_figure();
+    while (context->next_type != type);
+    copy_next_figure_to_figure();
+    init_figure_position();
+    fig_pos->y += drop_distance();
+    attach_figure_to_field();
+    int filled = 0;
+    for (int j = 0; j < COLS_MAP; j++)
+      filled += (game->field[ROWS_MAP - 1][j] == PIECE_ID(type));
+    ck_assert_int_gt(filled, 0);
+    for (int i = -HIDDEN_ROWS; i < ROWS_MAP; i++)
+      for (int j = 0; j < COLS_MAP; j++) game->field[i][j] = EMPTY_CELL;
+  }
+  for (int j = 0; j < COLS_MAP; j++) game->field[ROWS_MAP - 1][j] = 1;
+  game->field[ROWS_MAP - 2][0] = PIECE_ID(6);
+  ck_assert_int_eq(destruction_of_rows(), 1);
+  ck_assert_int_eq(game->field[ROWS_MAP - 1][0], PIECE_ID(6));
+  ck_assert_int_eq(CELL_FILLED(game->field[ROWS_MAP - 1][1]), 0);
+  free_game();
+}
+END_TEST
+
+/**
+ * @brief Test for frame time and input latency instrumentation
+ * @test Rolling histogram percentiles, eviction of old samples and cycle
+ * timestamps
+ * @pre Instrumentation state is empty
+ * @post Percentiles are within bucket precision, samples are recorded only for
+ * started cycles
+ */
+START_TEST(test_perf_stats) {
+  PerfHistogram_t hist = {0};
+  ck_assert_int_eq(perf_percentile(&hist, 50), 0);
+  for (int us = 1; us <= 100; us++) perf_histogram_add(&hist, us);
+  ck_assert_int_ge(perf_percentile(&hist, 50), 50);
+  ck_assert_int_le(perf_percentile(&hist, 50), 50 * 9 / 8);
+  ck_assert_int_ge(perf_percentile(&hist, 99), 99);
+  ck_assert_int_le(perf_percentile(&hist, 99), 99 * 9 / 8);
+  for (int i = 0; i < PERF_WINDOW; i++) perf_histogram_add(&hist, 1000);
+  ck_assert_int_eq(hist.n, PERF_WINDOW);
+  ck_assert_int_ge(perf_percentile(&hist, 1), 1000);
+  ck_assert_int_le(perf_percentile(&hist, 1), 1000 * 9 / 8);
+
+  PerfStats_t *perf = updatePerfStats();
+  perf_transition();
+  perf_render_done();
+  ck_assert_int_eq(perf->input.n + perf->frame.n, 0);
+  perf_cycle_start(false);
+  perf_transition();
+  perf_render_done();
+  ck_assert_int_eq(perf->input.n, 0);
+  ck_assert_int_eq(perf->frame.n, PERF_STATS);
+  perf_cycle_start(true);
+  perf_transition();
+  ck_assert_int_eq(perf->input.n, PERF_STATS);
+  perf_toggle();
+  ck_assert_int_eq(perf->visible, PERF_STATS);
+}
+END_TEST
+
+/**
+ * @brief Test for state machine and engine counters
+ * @test Handler call is counted with its transition, engine functions count
+ * their calls, counters are dumped as JSON
+ * @pre Game should be initialized
+ * @post Counters are written to the dump file
+ */
+START_TEST(test_perf_counters) {
+  init_game();
+  PerfStats_t *perf = updatePerfStats();
+  *perf = (PerfStats_t){0};
+  userInput(Start, false);
+  ck_assert_int_eq(*updateTetrisState(), SPAWN);
+  ck_assert_int_eq(perf->state_calls[START], PERF_STATS);
+  ck_assert_int_eq(perf->transitions[START][SPAWN], PERF_STATS);
+  ck_assert_int_eq(perf->func_calls[PERF_ASSIGN_NEXT_FIGURE], PERF_STATS);
+  check_collide();
+  check_collide();
+  ck_assert_int_eq(perf->func_calls[PERF_CHECK_COLLIDE], 2 * PERF_STATS);
+
+  char path[] = "/tmp/tetris_stats_XXXXXX";
+  int fd = mkstemp(path);
+  ck_assert_int_ge(fd, 0);
+  close(fd);
+  ck_assert_int_eq(perf_dump(path), NO_ERROR);
+  char buf[4096] = {0};
+  FILE *in = fopen(path, "r");
+  ck_assert_ptr_nonnull(in);
+  fread(buf, 1, sizeof(buf) - 1, in);
+  fclose(in);
+  unlink(path);
+  ck_assert_ptr_nonnull(strstr(buf, "\"functions\": {"));
+  if (PERF_STATS) {
+    ck_assert_ptr_nonnull(strstr(buf, "\"START\": {\"SPAWN\": 1}"));
+    ck_assert_ptr_nonnull(strstr(buf, "\"check_collide\": 2"));
+  }
+  ck_assert_int_eq(perf_dump("/nonexistent/stats.json"), ERROR);
+  free_game();
+}
+END_TEST
+
+#if TRACE
+/**
+ * @brief Test for event trace
+ * @test State handler and high score file I/O are recorded as begin/end
+ * events, ring keeps the latest TRACE_EVENTS events, export is Chrome trace
+ * JSON
+ * @pre Game should be initialized
+ * @post Trace is written to the export file
+ */
+START_TEST(test_trace) {
+  init_game();
+  userInput(Start, false);
+  high_score_update();
+  for (int i = 0; i < TRACE_EVENTS; i++) TRACE_BEGIN(TRACE_RENDER, i);
+
+  char path[] = "/tmp/tetris_trace_XXXXXX";
+  int fd = mkstemp(path);
+  ck_assert_int_ge(fd, 0);
+  close(fd);
+  ck_assert_int_eq(trace_export(path), NO_ERROR);
+  static char buf[TRACE_EVENTS * 128];
+  FILE *in = fopen(path, "r");
+  ck_assert_ptr_nonnull(in);
+  size_t n = fread(buf, 1, sizeof(buf) - 1, in);
+  buf[n] = '\0';
+  fclose(in);
+  unlink(path);
+  ck_assert_ptr_nonnull(strstr(buf, "{\"displayTimeUnit\": \"ms\", "));
+  ck_assert_ptr_null(strstr(buf, "\"high_score_io\""));
+  ck_assert_ptr_nonnull(strstr(buf, "\"render\", \"ph\": \"B\""));
+  char last[64];
+  snprintf(last, sizeof(last), "{\"arg\": %d}}\n]}", TRACE_EVENTS - 1);
+  ck_assert_ptr_nonnull(strstr(buf, last));
+  free_game();
+}
+END_TEST
+#endif
+
+/**
+ * @brief Test for event loop
+ * @test Periodic timer, deferred frame, watched descriptor and loop signals
+ * wake up the loop with their events, ready descriptor comes before a frame
+ * that is not due, SIGTERM is turned into INPUT_TERMINATE input
+ * @pre Event loop is created, stdin is not watched
+ * @post Event loop is closed
+ */
+START_TEST(test_events) {
+  EventLoop_t *loop = updateEventLoop();
+  ck_assert_int_eq(events_wait().type, EVENT_TERMINATE);
+  ck_assert_int_eq(events_init(), NO_ERROR);
+  loop->fds[0].fd = -1;
+  events_set_timer(5);
+  int64_t start = monotonic_ms();
+  ck_assert_int_eq(events_wait().type, EVENT_TIMER);
+  ck_assert_int_eq(events_read_input(true), INPUT_TICK);
+  ck_assert_int_ge(monotonic_ms() - start, 9);
+  events_set_timer(-1);
+
+  start = monotonic_ms();
+  events_defer_frame(start + 10);
+  ck_assert_int_eq(events_read_input(true), INPUT_FRAME);
+  ck_assert_int_ge(monotonic_ms() - start, 10);
+  ck_assert_int_eq(loop->frame_at, 0);
+
+  int p[2];
+  ck_assert_int_eq(pipe(p), 0);
+  ck_assert_int_eq(events_watch(p[0], NULL), NO_ERROR);
+  ck_assert_int_eq(write(p[1], "x", 1), 1);
+  events_defer_frame(monotonic_ms() + 1000);
+  Event_t ev = events_wait();
+  ck_assert_int_eq(ev.type, EVENT_FD);
+  ck_assert_int_eq(ev.fd, p[0]);
+  ck_assert_int_gt(loop->frame_at, 0);
+  events_defer_frame(0);
+  events_unwatch(p[0]);
+  ck_assert_int_eq(loop->nfds, 3);
+
+  raise(SIGWINCH);
+  ck_assert_int_eq(events_wait().type, EVENT_RESIZE);
+  raise(SIGWINCH);
+  ck_assert_int_eq(events_read_input(false), INPUT_RESIZE);
+  raise(SIGTERM);
+  ck_assert_int_eq(events_wait_key(), INPUT_TERMINATE);
+  events_free();
+  ck_assert_int_eq(loop->nfds, 0);
+  close(p[0]);
+  close(p[1]);
+}
+END_TEST
+
+/**
+ * @brief Test for versus mode
+ * @test Peer connects to listening game, its garbage is cancelled by cleared
+ * rows, the rest of cleared rows garbage is sent back, pending garbage is
+ * inserted at the bottom and peer game over ends local game
+ * @pre Event loop is created, game listens on socket path
+ * @post Sockets are closed, socket path is removed
+ */
+START_TEST(test_versus) {
+  char const *path = "./out/test_versus.sock";
+  Versus_t *vs = updateVersus();
+  uint8_t buf[VERSUS_MSG_SIZE];
+  init_game();
+  ck_assert_int_eq(events_init(), NO_ERROR);
+  updateEventLoop()->fds[0].fd = -1;
+  ck_assert_int_eq(versus_init(path), NO_ERROR);
+  ck_assert_int_ge(vs->listen_fd, 0);
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  strcpy(addr.sun_path, path);
+  int peer = socket(AF_UNIX, SOCK_STREAM, 0);
+  ck_assert_int_eq(connect(peer, (struct sockaddr *)&addr, sizeof(addr)), 0);
+  ck_assert_int_eq(events_read_input(false), INPUT_NONE);
+  ck_assert_int_ge(vs->fd, 0);
+  ck_assert_int_eq(vs->listen_fd, -1);
+
+  versus_encode((VersusMsg_t){VERSUS_MSG_GARBAGE, 3, 0, 0}, buf);
+  ck_assert_int_eq(write(peer, buf, 5), 5);
+  ck_assert_int_eq(events_read_input(false), INPUT_NONE);
+  ck_assert_int_eq(vs->pending_garbage, 0);
+  ck_assert_int_eq(write(peer, buf + 5, 3), 3);
+  ck_assert_int_eq(events_read_input(false), INPUT_NONE);
+  ck_assert_int_eq(vs->pending_garbage, 3);
+
+  versus_rows_cleared(4);
+  ck_assert_int_eq(vs->pending_garbage, 0);
+  ck_assert_int_eq(read(peer, buf, VERSUS_MSG_SIZE), VERSUS_MSG_SIZE);
+  VersusMsg_t msg = versus_decode(buf);
+  ck_assert_int_eq(msg.type, VERSUS_MSG_GARBAGE);
+  ck_assert_int_eq(msg.arg, 1);
+
+  vs->pending_garbage = 2;
+  updateCurrentState()->field[ROWS_MAP - 1][0] = PIECE_ID(0);
+  versus_figure_locked();
+  cell_t(*field)[COLS_MAP] = updateGameState()->field + HIDDEN_ROWS;
+  int holes = 0;
+  for (int j = 0; j < COLS_MAP; j++)
+    holes += !CELL_FILLED(field[ROWS_MAP - 1][j]);
+  ck_assert_int_eq(holes, 1);
+  ck_assert_int_eq(field[ROWS_MAP - 3][0], PIECE_ID(0));
+  ck_assert_int_eq(read(peer, buf, VERSUS_MSG_SIZE), VERSUS_MSG_SIZE);
+  msg = versus_decode(buf);
+  ck_assert_int_eq(msg.type, VERSUS_MSG_DIGEST);
+  ck_assert_int_eq(msg.value, 3);
+  ck_assert_uint_eq(msg.data, versus_field_digest());
+
+  versus_encode((VersusMsg_t){VERSUS_MSG_GAMEOVER, 0, 0, 0}, buf);
+  ck_assert_int_eq(write(peer, buf, VERSUS_MSG_SIZE), VERSUS_MSG_SIZE);
+  ck_assert_int_eq(get_action(events_read_input(false)), Terminate);
+  close(peer);
+  ck_assert_int_eq(events_read_input(false), INPUT_NONE);
+  ck_assert_int_eq(vs->fd, -1);
+  versus_free();
+  events_free();
+  free_game();
+  ck_assert_int_ne(access(path, F_OK), 0);
+}
+END_TEST
+
+/**
+ * @brief Test for versus send queue of a peer that does not read
+ * @test Inputs are dropped on full queue, garbage evicts queued inputs, garbage
+ * and game over that find the queue full of other messages are kept aside;
+ * sender never waits, peer that reads later gets all garbage, then game over
+ * @pre Event loop is created, peer is connected
+ * @post Sockets are closed, socket path is removed
+ */
+START_TEST(test_versus_send_queue) {
+  char const *path = "./out/test_versus_queue.sock";
+  Versus_t *vs = updateVersus();
+  uint8_t buf[VERSUS_MSG_SIZE];
+  init_game();
+  ck_assert_int_eq(events_init(), NO_ERROR);
+  updateEventLoop()->fds[0].fd = -1;
+  ck_assert_int_eq(versus_init(path), NO_ERROR);
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  strcpy(addr.sun_path, path);
+  int peer = socket(AF_UNIX, SOCK_STREAM, 0);
+  ck_assert_int_eq(connect(peer, (struct sockaddr *)&addr, sizeof(addr)), 0);
+  ck_assert_int_eq(events_read_input(false), INPUT_NONE);
+  ck_assert_int_ge(vs->fd, 0);
+
+  while (vs->dropped == 0) versus_send_input(Left);
+  int64_t start = monotonic_ms();
+  int dropped = vs->dropped;
+  versus_rows_cleared(4);
+  ck_assert_int_gt(vs->dropped, dropped);
+  ck_assert_int_eq(vs->unsent_garbage, 0);
+  while (vs->tx_len + VERSUS_MSG_SIZE <= VERSUS_TX_SIZE)
+    versus_send((VersusMsg_t){VERSUS_MSG_LOCKSTEP, Left, 0, 0});
+  versus_rows_cleared(4);
+  versus_game_over();
+  ck_assert_int_lt(monotonic_ms() - start, 100);
+  ck_assert_int_eq(vs->unsent_garbage, 4);
+  ck_assert_int_eq(vs->unsent_over, 1);
+
+  int garbage = 0;
+  int over = 0;
+  fcntl(peer, F_SETFL, O_NONBLOCK);
+  for (int i = 0; i < 1000 && !over && vs->fd >= 0; i++) {
+    while (!over && read(peer, buf, VERSUS_MSG_SIZE) == VERSUS_MSG_SIZE) {
+      VersusMsg_t msg = versus_decode(buf);
+      if (msg.type == VERSUS_MSG_GARBAGE) garbage += msg.arg;
+      over = msg.type == VERSUS_MSG_GAMEOVER;
+    }
+    versus_on_ready(vs->fd);
+  }
+  ck_assert_int_eq(over, 1);
+  ck_assert_int_eq(garbage, 8);
+  ck_assert_int_eq(vs->sent_garbage, 8);
+  ck_assert_int_ge(vs->fd, 0);
+  close(peer);
+  versus_free();
+  events_free();
+  free_game();
+}
+END_TEST
+
+/**
+ * @brief Test for spectator broadcast
+ * @test Spectators get key frame on connect and one delta message per frame
+ * with changed cells only, spectator that does not read is dropped while the
+ * other one keeps getting frames
+ * @pre Event loop is created, game listens on broadcast socket path
+ * @post Sockets are closed, socket path is removed
+ */
+START_TEST(test_broadcast) {
+  char const *path = "./out/test_broadcast.sock";
+  Broadcast_t *bc = updateBroadcast();
+  static uint8_t buf[BROADCAST_MSG_MAX];
+  init_game();
+  ck_assert_int_eq(events_init(), NO_ERROR);
+  updateEventLoop()->fds[0].fd = -1;
+  ck_assert_int_eq(broadcast_init(path), NO_ERROR);
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  strcpy(addr.sun_path, path);
+  int fast = socket(AF_UNIX, SOCK_STREAM, 0);
+  int slow = socket(AF_UNIX, SOCK_STREAM, 0);
+  ck_assert_int_eq(connect(fast, (struct sockaddr *)&addr, sizeof(addr)), 0);
+  ck_assert_int_eq(connect(slow, (struct sockaddr *)&addr, sizeof(addr)), 0);
+  ck_assert_int_eq(events_read_input(false), INPUT_NONE);
+  ck_assert_int_eq(bc->n_clients, 2);
+  int key = BROADCAST_HEADER_SIZE + BROADCAST_CELL_SIZE * ROWS_MAP * COLS_MAP;
+  ck_assert_int_eq(read(fast, buf, sizeof(buf)), key);
+  ck_assert_int_eq(buf[0], 'K');
+
+  broadcast_frame();
+  ck_assert_int_eq(bc->frame, 0);
+  updateCurrentState()->field[ROWS_MAP - 1][2] = PIECE_ID(3);
+  broadcast_frame();
+  ck_assert_int_eq(read(fast, buf, sizeof(buf)),
+                   BROADCAST_HEADER_SIZE + BROADCAST_CELL_SIZE);
+  ck_assert_int_eq(buf[0], 'D');
+  ck_assert_int_eq(buf[2], 1);
+  ck_assert_int_eq(buf[4], 1);
+  ck_assert_int_eq(buf[8], ROWS_MAP - 1);
+  ck_assert_int_eq(buf[9], 2);
+  ck_assert_int_eq(buf[10], PIECE_ID(3));
+
+  cell_t(*field)[COLS_MAP] = updateGameState()->field + HIDDEN_ROWS;
+  for (int n = 0; bc->n_clients == 2 && n < 100000; n++) {
+    memset(field, n % 2, sizeof(cell_t) * ROWS_MAP * COLS_MAP);
+    broadcast_frame();
+    ck_assert_int_gt(read(fast, buf, sizeof(buf)), 0);
+  }
+  ck_assert_int_eq(bc->n_clients, 1);
+  ck_assert_int_eq(bc->dropped, 1);
+  ck_assert_int_eq(read(slow, buf, 1), 1);
+  broadcast_free();
+  events_free();
+  free_game();
+  ck_assert_int_ne(access(path, F_OK), 0);
+  close(fast);
+  close(slow);
+}
+END_TEST
+
+/**
+ * @brief Test for lockstep netplay
+ * @test Two netplay states exchange inputs, input of player 1 reaches player
+ * 0 late, so player 0 rolls back mispredicted frames
+ * @pre Game should be initialized
+ * @post Both sides simulate the same games, simulation stalls without peer
+ * input
+ */
+START_TEST(test_netplay) {
+  static Netplay_t a;
+  static Netplay_t b;
+  VersusMsg_t late[8];
+  VersusMsg_t msg;
+  UserAction_t const moves[] = {Left, Action, Right, Right, Down};
+  init_game();
+  netplay_start(&a, 1234, 0);
+  netplay_start(&b, 1234, 1);
+  ck_assert_mem_eq(&a.sim, &b.sim, sizeof(a.sim));
+  for (int n = 0; n < 600; n++) {
+    ck_assert_int_eq(netplay_tick(&a, moves[n / 17 % 5], &msg), 1);
+    netplay_remote_input(&b, msg);
+    if (n >= 8) netplay_remote_input(&a, late[n % 8]);
+    ck_assert_int_eq(netplay_tick(&b, moves[n / 11 % 5], &late[n % 8]), 1);
+  }
+  for (int n = 600; n < 608; n++) netplay_remote_input(&a, late[n % 8]);
+  ck_assert_int_eq(netplay_tick(&a, No_signal, &msg), 1);
+  netplay_remote_input(&b, msg);
+  ck_assert_int_eq(netplay_tick(&b, No_signal, &msg), 1);
+  netplay_remote_input(&a, msg);
+  ck_assert_int_gt(a.rollbacks, 0);
+  ck_assert_int_gt(a.resimulated, a.rollbacks);
+  ck_assert_int_eq(b.rollbacks, 0);
+  ck_assert_int_eq(a.frame, b.frame);
+  for (int p = 0; p < 2; p++) {
+    ck_assert_mem_eq(a.sim.games[p].field, b.sim.games[p].field,
+                     sizeof(a.sim.games[p].field));
+    ck_assert_int_eq(a.sim.games[p].score, b.sim.games[p].score);
+    ck_assert_int_eq(a.sim.games[p].seed, b.sim.games[p].seed);
+    ck_assert_int_eq(a.sim.games[p].figure_pos.y, b.sim.games[p].figure_pos.y);
+    ck_assert_int_eq(a.sim.pending[p], b.sim.pending[p]);
+    ck_assert_int_eq(a.sim.over[p], b.sim.over[p]);
+  }
+  ck_assert_int_ne(netplay_result(&a), -1);
+  ck_assert_int_eq(netplay_result(&a) + netplay_result(&b),
+                   !a.sim.over[0] || !a.sim.over[1]);
+  ck_assert_mem_eq(updateGameState(), &b.sim.games[1], sizeof(GameState_t));
+
+  int ahead = NETPLAY_MAX_ROLLBACK + NETPLAY_INPUT_DELAY;
+  for (int n = 0; n <= ahead; n++)
+    ck_assert_int_eq(netplay_tick(&a, No_signal, &msg), n < ahead);
+  ck_assert_int_gt(a.stalls, 0);
+  free_game();
+}
+END_TEST
+
+/**
+ * @brief Test for flat game state copy
+ * @test Game state copied by assignment restores the whole game, including
+ * figure random generator
+ * @pre Game should be initialized
+ * @post Restored game produces the same figures as the original one
+ */
+START_TEST(test_game_state_snapshot) {
+  init_game();
+  GameState_t *st = updateGameState();
+  ck_assert_int_eq((uintptr_t)st % 64, 0);
+  assign_next_figure();
+  GameState_t snap = *st;
+  assign_next_figure();
+  copy_next_figure_to_figure();
+  init_figure_position();
+  attach_figure_to_field();
+  GameState_t played = *st;
+  *st = snap;
+  assign_next_figure();
+  copy_next_figure_to_figure();
+  init_figure_position();
+  attach_figure_to_field();
+  ck_assert_mem_eq(st, &played, sizeof(played));
+  ck_assert_ptr_eq(updateCurrentState()->field[0], st->field[HIDDEN_ROWS]);
   free_game();
 }
 END_TEST
@@ -387,7 +1316,69 @@ START_TEST(test_on_attaching_state) {
   userInput(No_signal, false);
   ck_assert_int_eq(*updateTetrisState(), SPAWN);
 
-  free_field(figure);
+  free_game();
+}
+END_TEST
+
+/**
+ * @brief Test for counters of actions, figures and cleared rows
+ * @test Action in MOVING state and lock of a figure clearing one row in
+ * ATTACHING state update counters, figure that the cleared row held whole is
+ * counted once and next one spawns, pause and terminate are not counted as
+ * inputs
+ * @pre Game should be initialized
+ * @post Counters are seen in GameInfo_t
+ */
+START_TEST(test_game_counters) {
+  TetrisState_t *state = updateTetrisState();
+  init_game();
+  int **figure = updateFigure();
+  GameInfo_t *game = updateCurrentState();
+  FigurePos_t *fig_pos = updateFigurePosition();
+  *state = MOVING;
+  userInput(Action, false);
+  userInput(No_signal, false);
+  ck_assert_int_eq(updateCurrentState()->inputs, 1);
+  for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++)
+    for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++) figure[i][j] = (j == 2);
+  for (int j = 0; j < COLS_MAP; j++)
+    game->field[ROWS_MAP - 1][j] = (j == 2) ? EMPTY_CELL : PIECE_ID(0);
+  fig_pos->x = 0;
+  fig_pos->y = ROWS_MAP - SIDE_OF_FIGURE_SQUARE;
+  *state = ATTACHING;
+  userInput(No_signal, false);
+  game = updateCurrentState();
+  ck_assert_int_eq(game->pieces, 1);
+  ck_assert_int_eq(game->lines, 1);
+  ck_assert_int_eq(game->clears[0], 1);
+  ck_assert_int_eq(game->clears[3], 0);
+  ck_assert_int_eq(game->inputs, 1);
+
+  for (int i = 0; i < SIDE_OF_FIGURE_SQUARE; i++)
+    for (int j = 0; j < SIDE_OF_FIGURE_SQUARE; j++)
+      figure[i][j] = (i == SIDE_OF_FIGURE_SQUARE - 1);
+  for (int i = 0; i < ROWS_MAP; i++)
+    for (int j = 0; j < COLS_MAP; j++)
+      game->field[i][j] = (i == ROWS_MAP - 1 && j >= SIDE_OF_FIGURE_SQUARE)
+                              ? PIECE_ID(0)
+                              : EMPTY_CELL;
+  fig_pos->x = 0;
+  fig_pos->y = ROWS_MAP - SIDE_OF_FIGURE_SQUARE;
+  *state = ATTACHING;
+  userInput(No_signal, false);
+  game = updateCurrentState();
+  ck_assert_int_eq(*state, SPAWN);
+  ck_assert_int_eq(game->pieces, 2);
+  ck_assert_int_eq(game->lines, 2);
+  for (int j = 0; j < COLS_MAP; j++)
+    ck_assert_int_eq(game->field[ROWS_MAP - 1][j], EMPTY_CELL);
+
+  *state = MOVING;
+  userInput(Pause, false);
+  *state = MOVING;
+  userInput(Terminate, false);
+  ck_assert_int_eq(*state, GAMEOVER);
+  ck_assert_int_eq(updateCurrentState()->inputs, 1);
   free_game();
 }
 END_TEST
@@ -452,13 +1443,35 @@ static Suite *create_tests(void) {
   tcase_add_test(tc_core, test_assign_next_figure);
   tcase_add_test(tc_core, test_copy_next_figure_to_figure);
   tcase_add_test(tc_core, test_high_score_update);
+  tcase_add_test(tc_core, test_leaderboard);
+  tcase_add_test(tc_core, test_leaderboard_concurrent);
+  tcase_add_test(tc_core, test_session_log);
   tcase_add_test(tc_core, test_recalculate_stats);
   tcase_add_test(tc_core, test_shift_rows_down);
+  tcase_add_test(tc_core, test_rotate_figure_with_kicks);
+  tcase_add_test(tc_core, test_compute_layout);
+  tcase_add_test(tc_core, test_arena_pool);
   tcase_add_test(tc_core, test_on_start_state);
   tcase_add_test(tc_core, test_on_spawn_state);
   tcase_add_test(tc_core, test_on_moving_state);
   tcase_add_test(tc_core, test_on_shifting_state);
+  tcase_add_test(tc_core, test_lock_delay);
+  tcase_add_test(tc_core, test_gravity);
+  tcase_add_test(tc_core, test_hidden_rows);
+  tcase_add_test(tc_core, test_attach_piece_id);
+  tcase_add_test(tc_core, test_game_state_snapshot);
+  tcase_add_test(tc_core, test_perf_stats);
+  tcase_add_test(tc_core, test_perf_counters);
+  tcase_add_test(tc_core, test_events);
+  tcase_add_test(tc_core, test_versus);
+  tcase_add_test(tc_core, test_versus_send_queue);
+  tcase_add_test(tc_core, test_broadcast);
+  tcase_add_test(tc_core, test_netplay);
+#if TRACE
+  tcase_add_test(tc_core, test_trace);
+#endif
   tcase_add_test(tc_core, test_on_attaching_state);
+  tcase_add_test(tc_core, test_game_counters);
   tcase_add_test(tc_core, test_on_gameover_state);
   tcase_add_test(tc_core, test_on_exit_error_state);
   tcase_add_test(tc_core, test_get_action);
@@ -473,6 +1486,16 @@ static Suite *create_tests(void) {
  */
 int main(void) {
   int number_failed;
+  static char dir[] = "/tmp/tetris_data_XXXXXX";
+  static char leaderboard[sizeof(dir) + 32];
+  static char log[sizeof(dir) + 32];
+  static char days[sizeof(dir) + 32];
+  if (mkdtemp(dir) == NULL) return EXIT_FAILURE;
+  snprintf(leaderboard, sizeof(leaderboard), "%s/leaderboard.bin", dir);
+  snprintf(log, sizeof(log), "%s/sessions.bin", dir);
+  snprintf(days, sizeof(days), "%s/session_days.bin", dir);
+  updateLeaderboard()->path = leaderboard; /**< Keep files of the game */
+  *updateSessionLog() = (SessionLog_t){.log_path = log, .days_path = days};
   Suite *s = create_tests();
   SRunner *sr = srunner_create(s);
 
@@ -480,6 +1503,10 @@ int main(void) {
   number_failed = srunner_ntests_failed(sr);
   srunner_free(sr);
   sr = NULL;
+  unlink(leaderboard);
+  unlink(log);
+  unlink(days);
+  rmdir(dir);
 
   return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file